@@ -8,10 +8,14 @@
 #define LAND_STOP_SIGNAL -1
 #define SQUIRREL_STOP_SIGNAL -2
 
+/** Checkpoint signal, the controller, the land actors and the batched squirrel actors write their state at the end of the month **/
+#define CHECKPOINT_SIGNAL -3
+
 /** Actor identity **/
 #define CONTROLLER_ACTOR 0
 #define LAND_ACTOR 1
 #define SQUIRREL_ACTOR 2
+#define SQUIRREL_BATCH_ACTOR 3
 
 /** Squirrel state **/
 #define NOT_EXIST 0
@@ -21,12 +25,27 @@
 #define CATCH_DISEASE 4
 #define TERMINATE 5
 
+/** Epoch signal, a squirrel actor has made all its steps of the month **/
+#define EPOCH_DONE 6
+
+/** Lease signal, a batched squirrel actor asks for more births it can decide by itself **/
+#define LEASE 7
+
+/** The counts a batched squirrel actor keeps for the controller between two reports, for the accounting reduction **/
+#define ACCOUNT_DIED 0
+#define ACCOUNT_CAUGHT 1
+#define ACCOUNT_BORN 2
+#define ACCOUNT_RETURNED 3  // The births of the lease a batched squirrel actor did not use, returned at the end of a month
+#define ACCOUNT_SIZE 4
+
 /** Communication tag **/
-#define IDENTITY_TAG 1024
 #define INITIAL_TAG 1025
 #define SQUIRREL_RECV_TAG 1026
 #define SQUIRREL_CONTROLLER_TAG 1027
 #define LAND_RECV_TAG 1028
 #define CONTROLLER_RECV_TAG 1029
+#define EPOCH_TAG 1030
+#define ACCOUNT_TAG 1031
+#define LEASE_TAG 1032
 
 #endif //SQUIRLSIM_ACTORCONFIG_H
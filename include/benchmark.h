@@ -0,0 +1,18 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_BENCHMARK_H
+#define SQUIRLSIM_BENCHMARK_H
+
+/**
+ * The numbers of a benchmark run. The controller times the run and its months, the MPI profile counts the
+ * point-to-point messages every process sends, and at the end the master writes them and the peak RSS of every process
+ * to BENCHMARK_OUTPUT as one JSON object.
+ */
+void startBenchmarkRun();
+void markBenchmarkMonth();
+void finishBenchmarkRun(long steps);
+void writeBenchmark(const char * path, int controllerPid);
+
+#endif //SQUIRLSIM_BENCHMARK_H
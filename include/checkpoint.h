@@ -0,0 +1,42 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_CHECKPOINT_H
+#define SQUIRLSIM_CHECKPOINT_H
+
+#include <stdint.h>
+#include "squirrel-block.h"
+
+/**
+ * A checkpoint is one file. It starts with the magic and the header, int64s indexed by the CHECKPOINT_ fields
+ * below. The cells of the land follow in the order of the grid, each one is its LAST_POPULATION_MONTHS population
+ * months and its LAST_INFECTION_MONTHS infection months. Then the squirrels: the id, x, y, state, steps and
+ * sickSteps of each one and its LAST_POPULATION_STEPS population and LAST_INFECTION_STEPS infection windows.
+ * The windows are kept in their rings, which are indexed by the month and the steps, and the random numbers of a
+ * squirrel are given by its id and its steps. The values are in the byte order of the machine.
+ */
+#define CHECKPOINT_MAGIC "SQCKPT01"
+#define CHECKPOINT_MAGIC_SIZE 8
+
+#define CHECKPOINT_MONTH 0
+#define CHECKPOINT_ALIVE 1
+#define CHECKPOINT_INFECTED 2
+#define CHECKPOINT_DEAD 3
+#define CHECKPOINT_STEPS 4
+#define CHECKPOINT_SQUIRRELS 5
+#define CHECKPOINT_WIDTH 6
+#define CHECKPOINT_HEIGHT 7
+#define CHECKPOINT_POPULATION_MONTHS 8
+#define CHECKPOINT_INFECTION_MONTHS 9
+#define CHECKPOINT_POPULATION_STEPS 10
+#define CHECKPOINT_INFECTION_STEPS 11
+#define CHECKPOINT_HEADER_FIELDS 12
+
+void writeCheckpoint(int month, int64_t * header, int firstCell, int cells, int * population, int * infection,
+                     struct SquirrelBlock * block);
+void readCheckpointHeader(const char * path, int64_t * header);
+void readCheckpointCells(const char * path, int firstCell, int cells, int * population, int * infection);
+void readCheckpointSquirrels(const char * path, long first, int count, struct SquirrelBlock * block);
+
+#endif //SQUIRLSIM_CHECKPOINT_H
@@ -8,20 +8,129 @@
 /** Controller parameters **/
 #define CONTROLLER_NUMBER 1
 
-/** Land parameters **/
-#define LENGTH_OF_LAND 16
-#define MONTH_LIMIT 24
-#define LAND_RENEW_RATE 0.000002
-#define LAST_POPULATION_MONTHS 3
-#define LAST_INFECTION_MONTHS 2
+/** Land message buffers **/
+#define LAND_RECV_SLOTS 16
+#define LAND_REPLY_SLOTS 16
+#define LAND_THREAD_CHUNK 4096
+
+/** Batched squirrel buffers **/
+#define SQUIRREL_BATCH_MIN_CAPACITY 64
+#define LAND_BATCH_VISITS 4096
+#define SQUIRREL_THREAD_CHUNK 1024
+
+/** Month output buffers, the months the controller can have in flight to the binary output **/
+#define MONTH_RECORD_SLOTS 4
+
+/**
+ * The parameters of a simulation. They are read at startup from the command line or a config file
+ * (see readSimConfig in config.c), the defaults are in config.c.
+ */
+struct SimConfig {
+    /** Land parameters **/
+    int landWidth;
+    int landHeight;
+    int landActors;
+    int landThreads;
+    int monthLimit;
+    double landRenewRate;
+    int lastPopulationMonths;
+    int lastInfectionMonths;
+    int landRmaMode;
+    int stepSyncMonths;
+    int stepsPerMonth;
+
+    /** Squirrel parameters **/
+    int maxSquirrelNumber;
+    int initialNumberOfSquirrels;
+    int initialInfectionLevel;
+    int giveBirthSteps;
+    int catchDiseaseSteps;
+    int lastPopulationSteps;
+    int lastInfectionSteps;
+    int squirrelRngSeed;
+
+    /** Batched squirrel parameters **/
+    int squirrelBatchActors;
+    int accountingReduceMode;
+    int birthLeaseSize;
+    int squirrelThreads;
+
+    /** Output parameters **/
+    char monthOutput[256];
+    int monthOutputCells;
+    int checkpointMonths;
+    char checkpointFile[256];
+    char restartFile[256];
+    char benchmarkOutput[256];
+    int mpiProfile;
+    char traceOutput[256];
+    int traceEvents;
+    int latencyHistograms;
+
+    /** Ensemble parameters **/
+    int ensembleReplicas;
+    char ensembleConfig[256];
+};
+
+extern struct SimConfig simConfig;
+
+/** Land parameters, the land is a grid of LAND_WIDTH x LAND_HEIGHT cells shared out over LAND_ACTORS actors **/
+#define LAND_WIDTH (simConfig.landWidth)
+#define LAND_HEIGHT (simConfig.landHeight)
+#define LENGTH_OF_LAND (simConfig.landWidth * simConfig.landHeight)
+#define LAND_ACTORS (simConfig.landActors)
+#define LAND_THREADS (simConfig.landThreads)
+#define MONTH_LIMIT (simConfig.monthLimit)
+#define LAND_RENEW_RATE (simConfig.landRenewRate)
+#define LAST_POPULATION_MONTHS (simConfig.lastPopulationMonths)
+#define LAST_INFECTION_MONTHS (simConfig.lastInfectionMonths)
+#define LAND_RMA_MODE (simConfig.landRmaMode)
+#define STEP_SYNC_MONTHS (simConfig.stepSyncMonths)
+#define STEPS_PER_MONTH (simConfig.stepsPerMonth)
 
 /** Squirrel parameters **/
-#define MAX_SQUIRREL_NUMBER 200
-#define INITIAL_NUMBER_OF_SQUIRRELS 34
-#define INITIAL_INFECTION_LEVEL 4
-#define GIVE_BIRTH_STEPS 50
-#define CATCH_DISEASE_STEPS 50
-#define LAST_POPULATION_STEPS 50
-#define LAST_INFECTION_STEPS 50
+#define MAX_SQUIRREL_NUMBER (simConfig.maxSquirrelNumber)
+#define INITIAL_NUMBER_OF_SQUIRRELS (simConfig.initialNumberOfSquirrels)
+#define INITIAL_INFECTION_LEVEL (simConfig.initialInfectionLevel)
+#define GIVE_BIRTH_STEPS (simConfig.giveBirthSteps)
+#define CATCH_DISEASE_STEPS (simConfig.catchDiseaseSteps)
+#define LAST_POPULATION_STEPS (simConfig.lastPopulationSteps)
+#define LAST_INFECTION_STEPS (simConfig.lastInfectionSteps)
+#define SQUIRREL_RNG_SEED (simConfig.squirrelRngSeed)
+
+/** Batched squirrel parameters **/
+#define SQUIRREL_BATCH_ACTORS (simConfig.squirrelBatchActors)
+#define ACCOUNTING_REDUCE_MODE (simConfig.accountingReduceMode)
+#define BIRTH_LEASE_SIZE (simConfig.birthLeaseSize)
+#define SQUIRREL_THREADS (simConfig.squirrelThreads)
+
+/** Output parameters, the months go to the binary file MONTH_OUTPUT instead of stdout if it is set **/
+#define MONTH_OUTPUT (simConfig.monthOutput)
+#define MONTH_OUTPUT_CELLS (simConfig.monthOutputCells)
+
+/** Checkpoints, every CHECKPOINT_MONTHS months to CHECKPOINT_FILE.<month>, and the checkpoint to restart from if it is set **/
+#define CHECKPOINT_MONTHS (simConfig.checkpointMonths)
+#define CHECKPOINT_FILE (simConfig.checkpointFile)
+#define RESTART_FILE (simConfig.restartFile)
+
+/** Benchmark output, the numbers of the run go to the JSON file BENCHMARK_OUTPUT if it is set **/
+#define BENCHMARK_OUTPUT (simConfig.benchmarkOutput)
+
+/** MPI profile, the calls, bytes and wait time of every role and tag are printed at the end when it is 1 **/
+#define MPI_PROFILE (simConfig.mpiProfile)
+
+/** Timeline trace, the spans of every process go to the Chrome trace TRACE_OUTPUT if it is set, TRACE_EVENTS spans per process at most **/
+#define TRACE_OUTPUT (simConfig.traceOutput)
+#define TRACE_EVENTS (simConfig.traceEvents)
+
+/** Latency histograms, the percentiles of the waits of the squirrels in every month are printed at the end when it is 1 **/
+#define LATENCY_HISTOGRAMS (simConfig.latencyHistograms)
+
+/** Ensemble parameters, ENSEMBLE_REPLICAS simulations in one job, replica r reads ENSEMBLE_CONFIG.<r> if it is set **/
+#define ENSEMBLE_REPLICAS (simConfig.ensembleReplicas)
+#define ENSEMBLE_CONFIG (simConfig.ensembleConfig)
+
+int readSimConfig(int argc, char * argv[]);
+int readReplicaConfig(const char * path);
 
 #endif //SQUIRLSIM_CONFIG_H
@@ -5,7 +5,9 @@
 #ifndef SQUIRLSIM_CONTROLLERACTOR_H
 #define SQUIRLSIM_CONTROLLERACTOR_H
 
-int controllerAsk(int workerPid);
+struct ActorInit;
+
+void controllerAsk(int index, struct ActorInit * init);
 int initialiseController();
 int controllerWorker();
 
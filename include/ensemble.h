@@ -0,0 +1,22 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_ENSEMBLE_H
+#define SQUIRLSIM_ENSEMBLE_H
+
+/**
+ * The months of the replicas of an ensemble. The controller of every replica keeps the squirrel counts of its
+ * months, and at the end the controller of replica 0 prints the mean, the standard deviation, the minimum and the
+ * maximum of each count per month over the replicas that got to the month.
+ */
+#define ENSEMBLE_ALIVE 0
+#define ENSEMBLE_INFECTED 1
+#define ENSEMBLE_DEAD 2
+#define ENSEMBLE_COUNTS 3
+
+void startEnsembleMonths();
+void recordEnsembleMonth(int month, int alive, int infected, int dead);
+void gatherEnsembleMonths();
+
+#endif //SQUIRLSIM_ENSEMBLE_H
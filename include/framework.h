@@ -1,30 +1,60 @@
 //
 // Created by Ray on 2020/2/28.
 //
+#include <stdint.h>
 #include "../include/config.h"
 #include "../include/actorConfig.h"
 
 #ifndef SQUIRLSIM_MAIN_H
 #define SQUIRLSIM_MAIN_H
 
-/** Arrays recording workers' pids **/
+/**
+ * The communicator of the simulation this process runs in, the pool, the actors and their pids use it instead of
+ * MPI_COMM_WORLD. With an ensemble MPI_COMM_WORLD is split into ENSEMBLE_REPLICAS of them, the controllers of the
+ * replicas gather the months in ensembleComm at the end. MPI_COMM_NULL on the other processes or without an ensemble.
+ */
+MPI_Comm simComm;
+MPI_Comm ensembleComm;
+int ensembleReplica;
+
+/**
+ * Arrays recording workers' pids, the ones sized by the simulation parameters are allocated at startup.
+ * Every process works them out at startup from the layout of the initial actors.
+ */
 int controllers[CONTROLLER_NUMBER];
-int cellWorkers[LENGTH_OF_LAND];
-int squirrelWorkers[INITIAL_NUMBER_OF_SQUIRRELS];
+int * cellWorkers;
+int * squirrelBatchWorkers;
+
+/**
+ * The communicator of the actors of this process's kind, split at startup: the land actors, or with the
+ * accounting reduction the controller (rank 0) and the batched squirrel actors. MPI_COMM_NULL otherwise.
+ */
+MPI_Comm actorComm;
 
-/** Global variables, that need to be accessed by the functions from other .c files **/
-int sickCount;
+/**
+ * The communicator of all the initial actors, with the controller as rank 0, that writes the checkpoints.
+ * MPI_COMM_NULL if there are no checkpoints.
+ */
+MPI_Comm checkpointComm;
 
-/** MPI World Group **/
-MPI_Group worldGroup;
+/**
+ * The record an actor is started with. An initial actor builds its own, a baby squirrel gets it from its
+ * parent in one message. The pids of the controller, the land actors and the batched squirrel actors are not
+ * in it, every process knows them.
+ */
+struct ActorInit {
+    int identity;     // What kind of actor the process is
+    int state;        // The state of a squirrel
+    int monthSteps;   // The steps a baby squirrel makes in the month it is born in
+    int month;        // The month a squirrel or a batched squirrel actor starts in, for the step-synchronous months
+    int block[3];     // The squirrels, the sick squirrels and the first id of a batched squirrel actor's block
+    uint64_t id;      // The id of a squirrel
+    float coord[2];   // Where a baby squirrel is born
+};
 
-typedef int (*WorkerFunc)();
+struct ActorInit actorInit;
+MPI_Datatype actorInitType;
 
-static int masterInitialiseWorker(int identity);
-static void masterInitialiseWorkers(int identity, int count, int * workerPids);
-static void masterInitialiseVariables();
-static void masterSendWorkers(int count, int workerPids[], WorkerFunc workerAskFunc);
-static void masterCode();
-static void workerCode(WorkerFunc initialiseFunc, WorkerFunc workerFunc);
+void sendActorInit(struct ActorInit * init, int workerPid);
 
 #endif //SQUIRLSIM_MAIN_H
@@ -5,7 +5,9 @@
 #ifndef SQUIRLSIM_LANDACTOR_H
 #define SQUIRLSIM_LANDACTOR_H
 
-int landAsk(int workerPid);
+struct ActorInit;
+
+void landAsk(int index, struct ActorInit * init);
 int initialiseLandCell();
 int landWorker();
 
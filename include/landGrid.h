@@ -0,0 +1,15 @@
+#ifndef _LAND_GRID_H
+#define _LAND_GRID_H
+
+// The cells of the land are shared out over the land actors in contiguous blocks of cell ids, a cell is routed
+// to the land actor that owns it and to its offset in the block of that actor
+
+int getLandOwner(int);
+
+int getLandFirstCell(int);
+
+int getLandCellCount(int);
+
+int getLandMaxCellCount();
+
+#endif
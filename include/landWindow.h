@@ -0,0 +1,33 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_LANDWINDOW_H
+#define SQUIRLSIM_LANDWINDOW_H
+
+#include <mpi.h>
+#include "config.h"
+
+/**
+ * The record of a land cell in the window of its land actor, the records of the actor's cells follow each other.
+ * A visit only touches the head of the record: the running sums of the population and infection windows, the
+ * current month of both and the stop flag set by the controller when the squirrels should stop. The older
+ * months follow, newest first.
+ */
+#define LAND_RECORD_POPULATION_SUM 0
+#define LAND_RECORD_INFECTION_SUM 1
+#define LAND_RECORD_POPULATION 2
+#define LAND_RECORD_INFECTION 3
+#define LAND_RECORD_STOP 4
+#define LAND_RECORD_VISIT_SIZE 5
+#define LAND_RECORD_OLD_POPULATION LAND_RECORD_VISIT_SIZE
+#define LAND_RECORD_OLD_INFECTION (LAND_RECORD_OLD_POPULATION + LAST_POPULATION_MONTHS - 1)
+#define LAND_RECORD_SIZE (LAND_RECORD_OLD_INFECTION + LAST_INFECTION_MONTHS - 1)
+
+void createLandWindow();
+void freeLandWindow();
+int visitLandWindow(int landPid, int count, const int * cells, const int * visits, const int * sickVisits, int * popNInf);
+void renewLandWindow(int landPid, int cells, int * popNInf);
+void stopLandWindow(int landPid, int cells, int * popNInf);
+
+#endif //SQUIRLSIM_LANDWINDOW_H
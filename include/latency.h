@@ -0,0 +1,28 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_LATENCY_H
+#define SQUIRLSIM_LATENCY_H
+
+/**
+ * The latency histograms. Every process counts the latencies of the squirrels it runs in log-bucketed histograms,
+ * one per month and kind of wait, like HDR histograms: the buckets are 1 ns wide up to 32 ns, then every power of two
+ * is split in LATENCY_SUB_BUCKETS buckets, so a latency is kept to within 1/LATENCY_SUB_BUCKETS of its value.
+ * At the end the histograms are added up over the processes and the master prints their percentiles.
+ */
+#define LATENCY_SQUIRL_GO 0
+#define LATENCY_REPRODUCE 1
+#define LATENCY_START_WORKER 2
+#define LATENCY_KINDS 3
+
+#define LATENCY_SUB_BUCKETS 16
+#define LATENCY_MAX_SHIFT 32  // The largest latency kept is 2^37 ns, about 137 s
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS * (LATENCY_MAX_SHIFT + 2))
+
+void startLatencyHistograms(int enabled);
+double latencyBegin();
+void recordLatency(int kind, int month, double begin);
+void printLatencyHistograms();
+
+#endif //SQUIRLSIM_LATENCY_H
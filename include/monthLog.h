@@ -0,0 +1,6 @@
+#ifndef _MONTH_LOG_H
+#define _MONTH_LOG_H
+
+void printMonthLog(int, int, int, int, int *, int);
+
+#endif
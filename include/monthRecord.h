@@ -0,0 +1,35 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_MONTHRECORD_H
+#define SQUIRLSIM_MONTHRECORD_H
+
+/**
+ * The binary month output. The file starts with a header, then has one record per month, all of the same size
+ * so month i is at MONTH_RECORD_HEADER_SIZE + i * the record size. The values are ints in the byte order of the
+ * machine that ran the simulation.
+ *
+ * The header is the magic, the number of land cells and whether the records have the cells.
+ * A record is the month, the alive, infected and dead squirrels and the last flag, which marks the output of a
+ * simulation that stopped before MONTH_LIMIT. With the cells, the (population, infection) pair of every cell
+ * follows, as in popNInf.
+ */
+#define MONTH_RECORD_MAGIC "SQMONTH1"
+#define MONTH_RECORD_MAGIC_SIZE 8
+#define MONTH_RECORD_HEADER_CELLS 0
+#define MONTH_RECORD_HEADER_WITH_CELLS 1
+#define MONTH_RECORD_HEADER_SIZE (MONTH_RECORD_MAGIC_SIZE + 2 * (int) sizeof(int))
+
+#define MONTH_RECORD_MONTH 0
+#define MONTH_RECORD_ALIVE 1
+#define MONTH_RECORD_INFECTED 2
+#define MONTH_RECORD_DEAD 3
+#define MONTH_RECORD_LAST 4
+#define MONTH_RECORD_COUNTS 5
+
+void openMonthRecords(const char * path, int cells, int withCells);
+void writeMonthRecord(int month, int alive, int infected, int dead, int last, int * popNInf);
+void closeMonthRecords();
+
+#endif //SQUIRLSIM_MONTHRECORD_H
@@ -0,0 +1,23 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_MPIPROFILE_H
+#define SQUIRLSIM_MPIPROFILE_H
+
+/**
+ * The MPI profile. The point-to-point, the completion, the collective and the one-sided calls of the simulation go
+ * through the PMPI wrappers in mpiProfile.c, which count the calls, the bytes and the time spent in them by the role
+ * the process has at the time and by the tag. The waits and the tests are counted by the tags of the requests
+ * they complete. The roles are the actor identities of actorConfig.h, and the pool for
+ * the master, the sub-masters and the workers between two actors.
+ */
+#define PROFILE_POOL 4
+#define PROFILE_ROLES 5
+
+void startMpiProfile(int enabled);
+void setMpiProfileRole(int role);
+long getMpiProfileMessages();
+void printMpiProfile();
+
+#endif //SQUIRLSIM_MPIPROFILE_H
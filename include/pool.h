@@ -7,7 +7,8 @@ enum PP_Control_Command {
 	PP_SLEEPING=1,
 	PP_WAKE=2,
 	PP_STARTPROCESS=3,
-	PP_RUNCOMPLETE=4
+	PP_RUNCOMPLETE=4,
+	PP_GROUPSTATE=5
 };
 
 // An example data package which combines the command with some optional data, an example and can be extended
@@ -16,6 +17,12 @@ struct PP_Control_Package {
     int data;
 };
 
+// Runs the pool on the processes of comm, MPI_COMM_WORLD by default, call it before processPoolPlan
+void processPoolSetComm(MPI_Comm comm);
+// Plans the pool with the first count workers awake at start, collective, call it before processPoolInit
+void processPoolPlan(int count);
+// The rank of a worker that is awake at start, the same on every process
+int getAwakeWorkerRank(int index);
 // Initialises the process pool
 int processPoolInit();
 // Finalises the process pool
@@ -0,0 +1,14 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_RING_H
+#define SQUIRLSIM_RING_H
+
+/**
+ * The slot of the non-negative index i in a ring buffer of size n, a mask when n is a power of two and
+ * otherwise a modulo.
+ */
+#define RING_SLOT(i, n) ((((n) & ((n) - 1)) == 0) ? ((i) & ((n) - 1)) : ((i) % (n)))
+
+#endif //SQUIRLSIM_RING_H
@@ -0,0 +1,36 @@
+#ifndef _SQUIRREL_BLOCK_H
+#define _SQUIRREL_BLOCK_H
+
+#include <stdint.h>
+
+// A block of squirrels stored as structure of arrays, it is shared by the batched squirrel actor and the threaded engine
+struct SquirrelBlock {
+    int count;      // The number of squirrels in the block
+    int capacity;   // The number of squirrels the arrays can hold
+    uint64_t * id;  // The id of the squirrel's random number stream
+    float * x;
+    float * y;
+    int * state;
+    int * steps;
+    int * sickSteps;
+    int * pop;  // capacity * LAST_POPULATION_STEPS, the window of squirrel i starts at i * LAST_POPULATION_STEPS
+    int * inf;  // capacity * LAST_INFECTION_STEPS, the window of squirrel i starts at i * LAST_INFECTION_STEPS
+    int * popSum;   // The running sum of the window in pop
+    int * infSum;   // The running sum of the window in inf
+};
+
+int reserveSquirrelBlock(struct SquirrelBlock *, int);
+
+void freeSquirrelBlock(struct SquirrelBlock *);
+
+int addSquirrelToBlock(struct SquirrelBlock *, uint64_t, float, float, int);
+
+int removeDeadSquirrelsFromBlock(struct SquirrelBlock *);
+
+void recordBlockVisit(struct SquirrelBlock *, int, int, int);
+
+float getBlockAvgPop(struct SquirrelBlock *, int);
+
+float getBlockAvgInfLevel(struct SquirrelBlock *, int);
+
+#endif
@@ -1,15 +1,17 @@
 #ifndef _HELPER_FUNCTIONS_H
 #define _HELPER_FUNCTIONS_H
 
-void initialiseRNG(long *);
+#include "squirrel-rng.h"
 
-void squirrelStep(float, float, float *, float *, long *);
+void squirrelStep(float, float, float *, float *, struct SquirrelRNG *);
 
-int willGiveBirth(float, long *);
+void squirrelStepBy(float, float, float, float, float *, float *);
 
-int willCatchDisease(float, long *);
+int willGiveBirth(float, struct SquirrelRNG *);
 
-int willDie(long *);
+int willCatchDisease(float, struct SquirrelRNG *);
+
+int willDie(struct SquirrelRNG *);
 
 int getCellFromPosition(float, float);
 
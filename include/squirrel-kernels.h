@@ -0,0 +1,17 @@
+#ifndef _SQUIRREL_KERNELS_H
+#define _SQUIRREL_KERNELS_H
+
+// The array at a time versions of the squirrel functions, they work on the structure of arrays of a block
+// and give an outcome mask (1 or 0 per squirrel) instead of branching
+
+float atanApprox(float);
+
+void squirrelStepBlock(int, float *, float *, const float *, const float *, int, int, int *);
+
+void willGiveBirthBlock(int, const float *, const float *, unsigned char *);
+
+void willCatchDiseaseBlock(int, const float *, const float *, unsigned char *);
+
+void willDieBlock(int, const float *, unsigned char *);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _SQUIRREL_RNG_H
+#define _SQUIRREL_RNG_H
+
+#include <stdint.h>
+
+// The streams of a squirrel. A step s draws from (s, MOVE) to move and from (s, LIFE) whether the squirrel catches
+// disease, gives birth and dies, always in this order, and a baby born in the step gets its id from (s, CHILD).
+// (0, PLACE) is the initial position
+#define SQUIRREL_RNG_MOVE 0
+#define SQUIRREL_RNG_LIFE 1
+#define SQUIRREL_RNG_PLACE 2
+#define SQUIRREL_RNG_CHILD 3
+
+// The numbers of the LIFE stream
+#define SQUIRREL_RNG_CATCH_DRAW 0
+#define SQUIRREL_RNG_BIRTH_DRAW 1
+#define SQUIRREL_RNG_DIE_DRAW 2
+
+// A counter based generator (Philox4x32-10), the draws are a function of (seed, squirrel id, step, stream)
+struct SquirrelRNG {
+    uint32_t key[2];      // The global seed
+    uint32_t counter[4];  // (stream and block, step, id low, id high)
+    uint32_t output[4];   // The words of the current block
+    int next;             // The next unused word of the current block
+};
+
+void seedSquirrelRNG(struct SquirrelRNG *, uint64_t, uint64_t);
+
+void seekSquirrelRNG(struct SquirrelRNG *, uint32_t, uint32_t);
+
+float squirrelRandom(struct SquirrelRNG *);
+
+uint64_t squirrelRandomId(struct SquirrelRNG *);
+
+void fillSquirrelRandom(uint64_t, const uint64_t *, const int *, uint32_t, int, float *);
+
+#endif
@@ -5,7 +5,9 @@
 #ifndef SQUIRLSIM_SQUIRRELACTOR_H
 #define SQUIRLSIM_SQUIRRELACTOR_H
 
-int squirrelAsk(int workerPid);
+struct ActorInit;
+
+void squirrelAsk(int index, struct ActorInit * init);
 int initialiseSquirrel();
 int squirrelWorker();
 
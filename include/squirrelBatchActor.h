@@ -0,0 +1,14 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_SQUIRRELBATCHACTOR_H
+#define SQUIRLSIM_SQUIRRELBATCHACTOR_H
+
+struct ActorInit;
+
+void squirrelBatchAsk(int index, struct ActorInit * init);
+int initialiseSquirrelBatch();
+int squirrelBatchWorker();
+
+#endif //SQUIRLSIM_SQUIRRELBATCHACTOR_H
@@ -0,0 +1,25 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#ifndef SQUIRLSIM_TRACE_H
+#define SQUIRLSIM_TRACE_H
+
+/**
+ * The timeline trace. Every process keeps the spans it goes through in a ring of TRACE_EVENTS spans, the oldest
+ * ones are dropped when it is full. At the end the master writes the spans of all the processes to TRACE_OUTPUT as
+ * one Chrome trace, which chrome://tracing and Perfetto load. The spans of the actors are the actor identities of
+ * actorConfig.h, the others are the waits below.
+ */
+#define TRACE_SPAWN 4
+#define TRACE_LAND_REPLY 5
+#define TRACE_MONTH_BARRIER 6
+#define TRACE_SLEEP 7
+#define TRACE_KINDS 8
+
+void startTrace(int enabled, int events);
+double traceBegin();
+void traceEnd(int kind, double begin);
+void writeTrace(const char * path);
+
+#endif //SQUIRLSIM_TRACE_H
@@ -0,0 +1,136 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <mpi.h>
+#include "../include/benchmark.h"
+#include "../include/mpiProfile.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+
+/** The run of the controller: the squirrel steps, the run time, and the months and their latency **/
+#define BENCHMARK_STEPS 0
+#define BENCHMARK_SECONDS 1
+#define BENCHMARK_MONTHS 2
+#define BENCHMARK_LATENCY_SUM 3
+#define BENCHMARK_LATENCY_MIN 4
+#define BENCHMARK_LATENCY_MAX 5
+#define BENCHMARK_RUN_SIZE 6
+
+static double benchmarkRun[BENCHMARK_RUN_SIZE];
+static double benchmarkStart;
+static double benchmarkMonthStart;
+
+/**
+ * @brief Start timing the run, the controller calls it before its first month
+ *
+ */
+void startBenchmarkRun(){
+    int i;
+    for (i=0; i<BENCHMARK_RUN_SIZE; i++)
+        benchmarkRun[i] = 0;
+
+    benchmarkStart = MPI_Wtime();
+    benchmarkMonthStart = benchmarkStart;
+}
+
+/**
+ * @brief Time the month that just finished, from the end of the month before it
+ *
+ */
+void markBenchmarkMonth(){
+    double now = MPI_Wtime(), latency = now - benchmarkMonthStart;
+
+    if (benchmarkRun[BENCHMARK_MONTHS] == 0 || latency < benchmarkRun[BENCHMARK_LATENCY_MIN])
+        benchmarkRun[BENCHMARK_LATENCY_MIN] = latency;
+    if (latency > benchmarkRun[BENCHMARK_LATENCY_MAX])
+        benchmarkRun[BENCHMARK_LATENCY_MAX] = latency;
+    benchmarkRun[BENCHMARK_LATENCY_SUM] += latency;
+    benchmarkRun[BENCHMARK_MONTHS]++;
+    benchmarkMonthStart = now;
+}
+
+/**
+ * @brief Stop timing the run
+ * @param[in] steps
+ * The squirrel steps of the run
+ *
+ */
+void finishBenchmarkRun(long steps){
+    benchmarkRun[BENCHMARK_STEPS] = (double) steps;
+    benchmarkRun[BENCHMARK_SECONDS] = MPI_Wtime() - benchmarkStart;
+}
+
+/**
+ * @brief Write the numbers of the run to a JSON file. It is collective over simComm, every process calls it after
+ * the pool is finalised, and the master writes the file.
+ * @param[in] path
+ * @param[in] controllerPid
+ * The controller that timed the run
+ *
+ */
+void writeBenchmark(const char * path, int controllerPid){
+    int i, rank, size;
+    long sent, messages, peakRss, maxPeakRss, * peakRssList;
+    double seconds, months;
+    struct rusage usage;
+    FILE * file;
+
+    MPI_Comm_rank(simComm, &rank);
+    MPI_Comm_size(simComm, &size);
+
+    // ru_maxrss is in KiB on Linux
+    getrusage(RUSAGE_SELF, &usage);
+    peakRss = usage.ru_maxrss;
+    peakRssList = (long *) malloc(sizeof(long) * (rank == 0 ? size : 1));
+    if (peakRssList == NULL) {
+        fprintf(stderr, "[Benchmark] Can not allocate the peak RSS of %d processes\n", size);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    sent = getMpiProfileMessages();
+    MPI_Reduce(&sent, &messages, 1, MPI_LONG, MPI_SUM, 0, simComm);
+    MPI_Gather(&peakRss, 1, MPI_LONG, peakRssList, 1, MPI_LONG, 0, simComm);
+    MPI_Bcast(benchmarkRun, BENCHMARK_RUN_SIZE, MPI_DOUBLE, controllerPid, simComm);
+
+    if (rank != 0) {
+        free(peakRssList);
+        return;
+    }
+
+    file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "[Benchmark] Can not open the benchmark output %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    seconds = benchmarkRun[BENCHMARK_SECONDS] > 0 ? benchmarkRun[BENCHMARK_SECONDS] : 1e-9;
+    months = benchmarkRun[BENCHMARK_MONTHS] > 0 ? benchmarkRun[BENCHMARK_MONTHS] : 1;
+    fprintf(file, "{\"ranks\": %d, \"landWidth\": %d, \"landHeight\": %d, \"landActors\": %d, ", size, LAND_WIDTH,
+            LAND_HEIGHT, LAND_ACTORS);
+    fprintf(file, "\"squirrelBatchActors\": %d, \"initialSquirrels\": %d, \"maxSquirrels\": %d, ", SQUIRREL_BATCH_ACTORS,
+            INITIAL_NUMBER_OF_SQUIRRELS, MAX_SQUIRREL_NUMBER);
+    fprintf(file, "\"stepSyncMonths\": %d, \"stepsPerMonth\": %d, \"months\": %.0f, ", STEP_SYNC_MONTHS, STEPS_PER_MONTH,
+            benchmarkRun[BENCHMARK_MONTHS]);
+    fprintf(file, "\"runtime\": %f, \"squirrelSteps\": %.0f, \"squirrelStepsPerSecond\": %.1f, ", seconds,
+            benchmarkRun[BENCHMARK_STEPS], benchmarkRun[BENCHMARK_STEPS] / seconds);
+    fprintf(file, "\"messages\": %ld, \"messagesPerSecond\": %.1f, ", messages, messages / seconds);
+    fprintf(file, "\"monthLatency\": {\"mean\": %f, \"min\": %f, \"max\": %f}, ",
+            benchmarkRun[BENCHMARK_LATENCY_SUM] / months, benchmarkRun[BENCHMARK_LATENCY_MIN],
+            benchmarkRun[BENCHMARK_LATENCY_MAX]);
+
+    maxPeakRss = 0;
+    fprintf(file, "\"peakRssKiB\": [");
+    for (i=0; i<size; i++) {
+        fprintf(file, i ? ", %ld" : "%ld", peakRssList[i]);
+        if (peakRssList[i] > maxPeakRss)
+            maxPeakRss = peakRssList[i];
+    }
+    fprintf(file, "], \"maxPeakRssKiB\": %ld}\n", maxPeakRss);
+
+    fclose(file);
+    free(peakRssList);
+}
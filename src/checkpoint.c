@@ -0,0 +1,287 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "../include/checkpoint.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+#include "../include/actorConfig.h"
+
+static MPI_Offset cellOffset(int cell);
+static MPI_Offset squirrelOffset(long squirrel);
+static int squirrelBytes();
+static char * allocateRecords(long bytes);
+static MPI_File openCheckpoint(const char * path);
+
+/**
+ * @brief Write the checkpoint of a month to CHECKPOINT_FILE.<month>, or CHECKPOINT_FILE.<month>.<replica> in an
+ * ensemble so a restart finds it from RESTART_FILE the way the replica does. It is collective over checkpointComm: the
+ * controller writes the header, every land actor the cells of its block and every batched squirrel actor the
+ * squirrels of its block, the squirrels of the blocks follow each other in the order of the actors.
+ * @param[in] month
+ * The month of the controller, the other actors get it from the controller
+ * @param[in,out] header
+ * The squirrel counts of the controller, NULL on the other actors. The rest is filled in here.
+ * @param[in] firstCell
+ * @param[in] cells
+ * The block of cells of a land actor, 0 cells on the other actors
+ * @param[in] population
+ * @param[in] infection
+ * The months of the cells, as the land actor keeps them
+ * @param[in] block
+ * The squirrels of a batched squirrel actor, NULL on the other actors
+ *
+ */
+void writeCheckpoint(int month, int64_t * header, int firstCell, int cells, int * population, int * infection,
+                     struct SquirrelBlock * block){
+    char path[sizeof(simConfig.checkpointFile) + 32], * buffer, * record;
+    long squirrels, first, total;
+    int i, rank, bytes;
+    MPI_Offset offset;
+    MPI_File file;
+
+    MPI_Bcast(&month, 1, MPI_INT, 0, checkpointComm);
+    if (ENSEMBLE_REPLICAS > 1)
+        snprintf(path, sizeof(path), "%s.%d.%d", CHECKPOINT_FILE, month, ensembleReplica);
+    else
+        snprintf(path, sizeof(path), "%s.%d", CHECKPOINT_FILE, month);
+    if (MPI_File_open(checkpointComm, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        fprintf(stderr, "[Checkpoint] Can not open the checkpoint %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(file, 0);
+
+    // The squirrels of this actor come after the ones of the actors before it
+    squirrels = block != NULL ? block->count : 0;
+    first = 0;
+    MPI_Comm_rank(checkpointComm, &rank);
+    MPI_Exscan(&squirrels, &first, 1, MPI_LONG, MPI_SUM, checkpointComm);
+    if (rank == 0)
+        first = 0;
+    MPI_Reduce(&squirrels, &total, 1, MPI_LONG, MPI_SUM, 0, checkpointComm);
+
+    if (header != NULL) {
+        header[CHECKPOINT_MONTH] = month;
+        header[CHECKPOINT_SQUIRRELS] = total;
+        header[CHECKPOINT_WIDTH] = LAND_WIDTH;
+        header[CHECKPOINT_HEIGHT] = LAND_HEIGHT;
+        header[CHECKPOINT_POPULATION_MONTHS] = LAST_POPULATION_MONTHS;
+        header[CHECKPOINT_INFECTION_MONTHS] = LAST_INFECTION_MONTHS;
+        header[CHECKPOINT_POPULATION_STEPS] = LAST_POPULATION_STEPS;
+        header[CHECKPOINT_INFECTION_STEPS] = LAST_INFECTION_STEPS;
+
+        bytes = (int) cellOffset(0);
+        buffer = allocateRecords(bytes);
+        memcpy(buffer, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_SIZE);
+        memcpy(buffer + CHECKPOINT_MAGIC_SIZE, header, sizeof(int64_t) * CHECKPOINT_HEADER_FIELDS);
+        offset = 0;
+    } else if (block != NULL) {
+        bytes = (int) (squirrels * squirrelBytes());
+        buffer = allocateRecords(bytes);
+        for (i=0; i<block->count; i++) {
+            record = buffer + (long) i * squirrelBytes();
+            memcpy(record, &block->id[i], sizeof(uint64_t));
+            record += sizeof(uint64_t);
+            memcpy(record, &block->x[i], sizeof(float));
+            memcpy(record + sizeof(float), &block->y[i], sizeof(float));
+            record += 2 * sizeof(float);
+            memcpy(record, &block->state[i], sizeof(int));
+            memcpy(record + sizeof(int), &block->steps[i], sizeof(int));
+            memcpy(record + 2 * sizeof(int), &block->sickSteps[i], sizeof(int));
+            record += 3 * sizeof(int);
+            memcpy(record, &block->pop[i * LAST_POPULATION_STEPS], sizeof(int) * LAST_POPULATION_STEPS);
+            memcpy(record + sizeof(int) * LAST_POPULATION_STEPS, &block->inf[i * LAST_INFECTION_STEPS],
+                   sizeof(int) * LAST_INFECTION_STEPS);
+        }
+        offset = squirrelOffset(first);
+    } else {
+        bytes = (int) (cellOffset(cells) - cellOffset(0));
+        buffer = allocateRecords(bytes);
+        for (i=0; i<cells; i++) {
+            record = buffer + (cellOffset(i) - cellOffset(0));
+            memcpy(record, &population[i * LAST_POPULATION_MONTHS], sizeof(int) * LAST_POPULATION_MONTHS);
+            memcpy(record + sizeof(int) * LAST_POPULATION_MONTHS, &infection[i * LAST_INFECTION_MONTHS],
+                   sizeof(int) * LAST_INFECTION_MONTHS);
+        }
+        offset = cellOffset(firstCell);
+    }
+
+    MPI_File_write_at_all(file, offset, buffer, bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    free(buffer);
+}
+
+/**
+ * @brief Read the header of a checkpoint, the land and the windows of the simulation have to be the ones of
+ * the checkpoint
+ * @param[in] path
+ * @param[out] header
+ * The CHECKPOINT_HEADER_FIELDS fields
+ *
+ */
+void readCheckpointHeader(const char * path, int64_t * header){
+    char magic[CHECKPOINT_MAGIC_SIZE];
+    MPI_File file = openCheckpoint(path);
+
+    MPI_File_read_at(file, 0, magic, CHECKPOINT_MAGIC_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_read_at(file, CHECKPOINT_MAGIC_SIZE, header, sizeof(int64_t) * CHECKPOINT_HEADER_FIELDS, MPI_BYTE,
+                     MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    if (memcmp(magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "[Checkpoint] %s is not a checkpoint of the simulation\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (header[CHECKPOINT_WIDTH] != LAND_WIDTH || header[CHECKPOINT_HEIGHT] != LAND_HEIGHT ||
+        header[CHECKPOINT_POPULATION_MONTHS] != LAST_POPULATION_MONTHS || header[CHECKPOINT_INFECTION_MONTHS] != LAST_INFECTION_MONTHS ||
+        header[CHECKPOINT_POPULATION_STEPS] != LAST_POPULATION_STEPS || header[CHECKPOINT_INFECTION_STEPS] != LAST_INFECTION_STEPS) {
+        fprintf(stderr, "[Checkpoint] %s has a land of %d x %d cells with windows of %d, %d months and %d, %d steps, "
+                        "the simulation should have the same\n", path, (int) header[CHECKPOINT_WIDTH], (int) header[CHECKPOINT_HEIGHT],
+                (int) header[CHECKPOINT_POPULATION_MONTHS], (int) header[CHECKPOINT_INFECTION_MONTHS],
+                (int) header[CHECKPOINT_POPULATION_STEPS], (int) header[CHECKPOINT_INFECTION_STEPS]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+/**
+ * @brief Read the months of a block of cells from a checkpoint, whatever land actor wrote them
+ * @param[in] path
+ * @param[in] firstCell
+ * @param[in] cells
+ * @param[out] population
+ * @param[out] infection
+ * The months of the cells, as the land actor keeps them
+ *
+ */
+void readCheckpointCells(const char * path, int firstCell, int cells, int * population, int * infection){
+    int i, bytes;
+    char * buffer, * record;
+    MPI_File file = openCheckpoint(path);
+
+    bytes = (int) (cellOffset(cells) - cellOffset(0));
+    buffer = allocateRecords(bytes);
+    MPI_File_read_at(file, cellOffset(firstCell), buffer, bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    for (i=0; i<cells; i++) {
+        record = buffer + (cellOffset(i) - cellOffset(0));
+        memcpy(&population[i * LAST_POPULATION_MONTHS], record, sizeof(int) * LAST_POPULATION_MONTHS);
+        memcpy(&infection[i * LAST_INFECTION_MONTHS], record + sizeof(int) * LAST_POPULATION_MONTHS,
+               sizeof(int) * LAST_INFECTION_MONTHS);
+    }
+    free(buffer);
+}
+
+/**
+ * @brief Read count squirrels from the first one on from a checkpoint and add them to a block, whatever batched
+ * squirrel actor wrote them. The running sums of their windows are worked out again.
+ * @param[in] path
+ * @param[in] first
+ * @param[in] count
+ * @param[in,out] block
+ *
+ */
+void readCheckpointSquirrels(const char * path, long first, int count, struct SquirrelBlock * block){
+    int i, j, k, bytes, state;
+    uint64_t id;
+    float x, y;
+    char * buffer, * record;
+    MPI_File file = openCheckpoint(path);
+
+    bytes = count * squirrelBytes();
+    buffer = allocateRecords(bytes);
+    MPI_File_read_at(file, squirrelOffset(first), buffer, bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    for (i=0; i<count; i++) {
+        record = buffer + (long) i * squirrelBytes();
+        memcpy(&id, record, sizeof(uint64_t));
+        record += sizeof(uint64_t);
+        memcpy(&x, record, sizeof(float));
+        memcpy(&y, record + sizeof(float), sizeof(float));
+        record += 2 * sizeof(float);
+        memcpy(&state, record, sizeof(int));
+
+        j = addSquirrelToBlock(block, id, x, y, state);
+        if (j < 0) {
+            fprintf(stderr, "[Checkpoint] Can not allocate the %d squirrels of the checkpoint\n", count);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        memcpy(&block->steps[j], record + sizeof(int), sizeof(int));
+        memcpy(&block->sickSteps[j], record + 2 * sizeof(int), sizeof(int));
+        record += 3 * sizeof(int);
+        memcpy(&block->pop[j * LAST_POPULATION_STEPS], record, sizeof(int) * LAST_POPULATION_STEPS);
+        memcpy(&block->inf[j * LAST_INFECTION_STEPS], record + sizeof(int) * LAST_POPULATION_STEPS,
+               sizeof(int) * LAST_INFECTION_STEPS);
+
+        for (k=0; k<LAST_POPULATION_STEPS; k++)
+            block->popSum[j] += block->pop[j * LAST_POPULATION_STEPS + k];
+        for (k=0; k<LAST_INFECTION_STEPS; k++)
+            block->infSum[j] += block->inf[j * LAST_INFECTION_STEPS + k];
+    }
+    free(buffer);
+}
+
+/**
+ * @brief The place of a cell in a checkpoint
+ * @param[in] cell
+ * @return The offset in bytes
+ *
+ */
+static MPI_Offset cellOffset(int cell){
+    return CHECKPOINT_MAGIC_SIZE + (MPI_Offset) sizeof(int64_t) * CHECKPOINT_HEADER_FIELDS +
+           (MPI_Offset) cell * sizeof(int) * (LAST_POPULATION_MONTHS + LAST_INFECTION_MONTHS);
+}
+
+/**
+ * @brief The place of a squirrel in a checkpoint, after all the cells
+ * @param[in] squirrel
+ * @return The offset in bytes
+ *
+ */
+static MPI_Offset squirrelOffset(long squirrel){
+    return cellOffset(LENGTH_OF_LAND) + (MPI_Offset) squirrel * squirrelBytes();
+}
+
+/**
+ * @brief The size of the record of a squirrel in a checkpoint
+ * @return The size in bytes
+ *
+ */
+static int squirrelBytes(){
+    return sizeof(uint64_t) + 2 * sizeof(float) + sizeof(int) * (3 + LAST_POPULATION_STEPS + LAST_INFECTION_STEPS);
+}
+
+/**
+ * @brief Allocate the buffer of the records an actor reads or writes
+ * @param[in] bytes
+ * @return The buffer, it is never NULL
+ *
+ */
+static char * allocateRecords(long bytes){
+    char * buffer = (char *) malloc(bytes > 0 ? bytes : 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "[Checkpoint] Can not allocate %ld bytes of records\n", bytes);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Open a checkpoint to read, each actor reads its own part of it
+ * @param[in] path
+ * @return The file
+ *
+ */
+static MPI_File openCheckpoint(const char * path){
+    MPI_File file;
+    if (MPI_File_open(MPI_COMM_SELF, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        fprintf(stderr, "[Checkpoint] Can not open the checkpoint %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return file;
+}
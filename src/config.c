@@ -0,0 +1,324 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/config.h"
+
+/** The default simulation **/
+struct SimConfig simConfig = {
+    .landWidth = 4,
+    .landHeight = 4,
+    .landActors = 16,
+    .landThreads = 1,
+    .monthLimit = 24,
+    .landRenewRate = 0.000002,
+    .lastPopulationMonths = 3,
+    .lastInfectionMonths = 2,
+    .landRmaMode = 0,
+    .stepSyncMonths = 0,
+    .stepsPerMonth = 50,
+
+    .maxSquirrelNumber = 200,
+    .initialNumberOfSquirrels = 34,
+    .initialInfectionLevel = 4,
+    .giveBirthSteps = 50,
+    .catchDiseaseSteps = 50,
+    .lastPopulationSteps = 50,
+    .lastInfectionSteps = 50,
+    .squirrelRngSeed = 2020,
+
+    .squirrelBatchActors = 0,
+    .accountingReduceMode = 0,
+    .birthLeaseSize = 0,
+    .squirrelThreads = 1,
+
+    .monthOutput = "",
+    .monthOutputCells = 1,
+    .checkpointMonths = 0,
+    .checkpointFile = "",
+    .restartFile = "",
+    .benchmarkOutput = "",
+    .mpiProfile = 0,
+    .traceOutput = "",
+    .traceEvents = 65536,
+    .latencyHistograms = 0,
+
+    .ensembleReplicas = 1,
+    .ensembleConfig = "",
+};
+
+/** The parameters by the names they have in config.h, and the smallest value each one can take **/
+static const struct {
+    const char * name;
+    int * value;
+    int min;
+} intParameters[] = {
+    {"LAND_WIDTH", &simConfig.landWidth, 1},
+    {"LAND_HEIGHT", &simConfig.landHeight, 1},
+    {"LAND_ACTORS", &simConfig.landActors, 1},
+    {"LAND_THREADS", &simConfig.landThreads, 1},
+    {"MONTH_LIMIT", &simConfig.monthLimit, 1},
+    {"LAST_POPULATION_MONTHS", &simConfig.lastPopulationMonths, 1},
+    {"LAST_INFECTION_MONTHS", &simConfig.lastInfectionMonths, 1},
+    {"LAND_RMA_MODE", &simConfig.landRmaMode, 0},
+    {"STEP_SYNC_MONTHS", &simConfig.stepSyncMonths, 0},
+    {"STEPS_PER_MONTH", &simConfig.stepsPerMonth, 1},
+    {"MAX_SQUIRREL_NUMBER", &simConfig.maxSquirrelNumber, 1},
+    {"INITIAL_NUMBER_OF_SQUIRRELS", &simConfig.initialNumberOfSquirrels, 0},
+    {"INITIAL_INFECTION_LEVEL", &simConfig.initialInfectionLevel, 0},
+    {"GIVE_BIRTH_STEPS", &simConfig.giveBirthSteps, 1},
+    {"CATCH_DISEASE_STEPS", &simConfig.catchDiseaseSteps, 0},
+    {"LAST_POPULATION_STEPS", &simConfig.lastPopulationSteps, 1},
+    {"LAST_INFECTION_STEPS", &simConfig.lastInfectionSteps, 1},
+    {"SQUIRREL_RNG_SEED", &simConfig.squirrelRngSeed, 0},
+    {"SQUIRREL_BATCH_ACTORS", &simConfig.squirrelBatchActors, 0},
+    {"ACCOUNTING_REDUCE_MODE", &simConfig.accountingReduceMode, 0},
+    {"BIRTH_LEASE_SIZE", &simConfig.birthLeaseSize, 0},
+    {"SQUIRREL_THREADS", &simConfig.squirrelThreads, 1},
+    {"MONTH_OUTPUT_CELLS", &simConfig.monthOutputCells, 0},
+    {"CHECKPOINT_MONTHS", &simConfig.checkpointMonths, 0},
+    {"ENSEMBLE_REPLICAS", &simConfig.ensembleReplicas, 1},
+    {"MPI_PROFILE", &simConfig.mpiProfile, 0},
+    {"TRACE_EVENTS", &simConfig.traceEvents, 1},
+    {"LATENCY_HISTOGRAMS", &simConfig.latencyHistograms, 0},
+};
+
+/** The parameters that are paths **/
+static const struct {
+    const char * name;
+    char * value;
+} stringParameters[] = {
+    {"MONTH_OUTPUT", simConfig.monthOutput},
+    {"CHECKPOINT_FILE", simConfig.checkpointFile},
+    {"RESTART_FILE", simConfig.restartFile},
+    {"BENCHMARK_OUTPUT", simConfig.benchmarkOutput},
+    {"TRACE_OUTPUT", simConfig.traceOutput},
+    {"ENSEMBLE_CONFIG", simConfig.ensembleConfig},
+};
+
+/** 1 once LAND_ACTORS is set, the default is cut down to the cells of a smaller land **/
+static int landActorsSet;
+
+static int setSimParameter(const char * name, const char * value, const char * where);
+static int readSimConfigFile(const char * path);
+static int checkSimConfig();
+
+/**
+ * @brief Read the parameters of the simulation from the command line, which looks like
+ *
+ *     run [-c file] [NAME=value ...]
+ *
+ * The names are the ones in config.h. The config file has one `NAME value` or `NAME=value` per line and
+ * `#` starts a comment. The parameters on the command line are applied after the file, in order, over the
+ * defaults in this file. Errors are written to stderr.
+ * @param[in] argc
+ * @param[in] argv
+ * @return 0 if the parameters are good, otherwise -1
+ *
+ */
+int readSimConfig(int argc, char * argv[]){
+    int i;
+    char name[64], * equals;
+
+    for (i=1; i<argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "[Config] -c needs a config file\n");
+                return -1;
+            }
+            if (readSimConfigFile(argv[++i])) return -1;
+            continue;
+        }
+
+        equals = strchr(argv[i], '=');
+        if (equals == NULL || equals - argv[i] >= (int) sizeof(name)) {
+            fprintf(stderr, "[Config] Can not understand the argument %s, use -c file or NAME=value\n", argv[i]);
+            return -1;
+        }
+        memcpy(name, argv[i], equals - argv[i]);
+        name[equals - argv[i]] = '\0';
+        if (setSimParameter(name, equals + 1, "the command line")) return -1;
+    }
+
+    return checkSimConfig();
+}
+
+/**
+ * @brief Read the config file of one replica of an ensemble, over the parameters the replica has so far
+ * @param[in] path
+ * @return 0 if the parameters are good, otherwise -1
+ *
+ */
+int readReplicaConfig(const char * path){
+    if (readSimConfigFile(path)) return -1;
+    return checkSimConfig();
+}
+
+/**
+ * @brief Read a config file, one parameter per line. The values have room for one character more than the
+ * paths, so setSimParameter rejects a path that is too long instead of taking the start of it.
+ * @param[in] path
+ * @return 0 on success, otherwise -1
+ *
+ */
+static int readSimConfigFile(const char * path){
+    char line[512], name[64], value[sizeof(simConfig.monthOutput) + 1], format[32], where[300], * c;
+    int lineNumber, fields;
+
+    snprintf(format, sizeof(format), "%%%ds %%%ds", (int) sizeof(name) - 1, (int) sizeof(value) - 1);
+
+    FILE * file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "[Config] Can not open the config file %s\n", path);
+        return -1;
+    }
+
+    lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        snprintf(where, sizeof(where), "%s:%d", path, lineNumber);
+        if (strchr(line, '\n') == NULL && !feof(file)) {
+            fprintf(stderr, "[Config] %s: The line is longer than %d characters\n", where, (int) sizeof(line) - 2);
+            fclose(file);
+            return -1;
+        }
+        if ((c = strchr(line, '#')) != NULL) *c = '\0';
+        if ((c = strchr(line, '=')) != NULL) *c = ' ';
+
+        fields = sscanf(line, format, name, value);
+        if (fields <= 0) continue;  // A blank line or a comment
+
+        if (fields == 1) {
+            fprintf(stderr, "[Config] %s: %s has no value\n", where, name);
+            fclose(file);
+            return -1;
+        }
+        if (setSimParameter(name, value, where)) {
+            fclose(file);
+            return -1;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/**
+ * @brief Set one parameter by its name
+ * @param[in] name
+ * The name of the parameter in config.h
+ * @param[in] value
+ * @param[in] where
+ * Where the parameter comes from, for the error message
+ * @return 0 on success, otherwise -1
+ *
+ */
+static int setSimParameter(const char * name, const char * value, const char * where){
+    int i;
+    long number;
+    double rate;
+    char * end;
+
+    if (strcmp(name, "LAND_RENEW_RATE") == 0) {
+        rate = strtod(value, &end);
+        if (*value == '\0' || *end != '\0' || rate <= 0) {
+            fprintf(stderr, "[Config] %s: LAND_RENEW_RATE should be a positive number of seconds, not %s\n", where, value);
+            return -1;
+        }
+        simConfig.landRenewRate = rate;
+        return 0;
+    }
+
+    // The paths all have the size of monthOutput
+    for (i=0; i<(int) (sizeof(stringParameters) / sizeof(stringParameters[0])); i++) {
+        if (strcmp(name, stringParameters[i].name) != 0) continue;
+
+        if (strlen(value) >= sizeof(simConfig.monthOutput)) {
+            fprintf(stderr, "[Config] %s: %s should be a path of less than %d characters\n", where, name,
+                    (int) sizeof(simConfig.monthOutput));
+            return -1;
+        }
+        strcpy(stringParameters[i].value, value);
+        return 0;
+    }
+
+    for (i=0; i<(int) (sizeof(intParameters) / sizeof(intParameters[0])); i++) {
+        if (strcmp(name, intParameters[i].name) != 0) continue;
+
+        number = strtol(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || number < intParameters[i].min || number > 0x7fffffff) {
+            fprintf(stderr, "[Config] %s: %s should be an integer from %d, not %s\n", where, name, intParameters[i].min, value);
+            return -1;
+        }
+        *intParameters[i].value = (int) number;
+        if (intParameters[i].value == &simConfig.landActors)
+            landActorsSet = 1;
+        return 0;
+    }
+
+    fprintf(stderr, "[Config] %s: There is no parameter %s\n", where, name);
+    return -1;
+}
+
+/**
+ * @brief Check the parameters that depend on each other. A land of fewer cells than the default LAND_ACTORS has
+ * a land actor per cell, unless LAND_ACTORS is set.
+ * @return 0 if the parameters are good, otherwise -1
+ *
+ */
+static int checkSimConfig(){
+    if ((long) LAND_WIDTH * LAND_HEIGHT > 0x7fffffff) {
+        fprintf(stderr, "[Config] The land of %d x %d cells is too large\n", LAND_WIDTH, LAND_HEIGHT);
+        return -1;
+    }
+    if (!landActorsSet && LAND_ACTORS > LENGTH_OF_LAND)
+        simConfig.landActors = LENGTH_OF_LAND;
+    if (LAND_ACTORS > LENGTH_OF_LAND) {
+        fprintf(stderr, "[Config] LAND_ACTORS %d is more than the %d cells of the land\n", LAND_ACTORS, LENGTH_OF_LAND);
+        return -1;
+    }
+    if (INITIAL_INFECTION_LEVEL > INITIAL_NUMBER_OF_SQUIRRELS) {
+        fprintf(stderr, "[Config] INITIAL_INFECTION_LEVEL %d is more than INITIAL_NUMBER_OF_SQUIRRELS %d\n",
+                INITIAL_INFECTION_LEVEL, INITIAL_NUMBER_OF_SQUIRRELS);
+        return -1;
+    }
+    if (INITIAL_NUMBER_OF_SQUIRRELS > MAX_SQUIRREL_NUMBER) {
+        fprintf(stderr, "[Config] INITIAL_NUMBER_OF_SQUIRRELS %d is more than MAX_SQUIRREL_NUMBER %d\n",
+                INITIAL_NUMBER_OF_SQUIRRELS, MAX_SQUIRREL_NUMBER);
+        return -1;
+    }
+    if (ACCOUNTING_REDUCE_MODE && (SQUIRREL_BATCH_ACTORS == 0 || STEP_SYNC_MONTHS == 0)) {
+        fprintf(stderr, "[Config] ACCOUNTING_REDUCE_MODE needs batched squirrel actors and STEP_SYNC_MONTHS\n");
+        return -1;
+    }
+    if (BIRTH_LEASE_SIZE && !ACCOUNTING_REDUCE_MODE) {
+        fprintf(stderr, "[Config] BIRTH_LEASE_SIZE needs ACCOUNTING_REDUCE_MODE to count the births\n");
+        return -1;
+    }
+    if (SQUIRREL_THREADS > 1 && SQUIRREL_BATCH_ACTORS == 0) {
+        fprintf(stderr, "[Config] SQUIRREL_THREADS needs batched squirrel actors, the threads step the squirrels of a block\n");
+        return -1;
+    }
+#ifndef _OPENMP
+    if (SQUIRREL_THREADS > 1 || LAND_THREADS > 1) {
+        fprintf(stderr, "[Config] SQUIRREL_THREADS and LAND_THREADS need a build with OpenMP, see the Makefile\n");
+        return -1;
+    }
+#endif
+    if (CHECKPOINT_MONTHS && CHECKPOINT_FILE[0] == '\0') {
+        fprintf(stderr, "[Config] CHECKPOINT_MONTHS needs CHECKPOINT_FILE\n");
+        return -1;
+    }
+    if ((CHECKPOINT_MONTHS || RESTART_FILE[0] != '\0') && (!ACCOUNTING_REDUCE_MODE || LAND_RMA_MODE)) {
+        fprintf(stderr, "[Config] The checkpoints need ACCOUNTING_REDUCE_MODE, and the land cells out of LAND_RMA_MODE\n");
+        return -1;
+    }
+    if (LATENCY_HISTOGRAMS && !STEP_SYNC_MONTHS) {
+        fprintf(stderr, "[Config] LATENCY_HISTOGRAMS needs STEP_SYNC_MONTHS, so that the squirrels know their month\n");
+        return -1;
+    }
+    return 0;
+}
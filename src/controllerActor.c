@@ -3,14 +3,22 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <mpi.h>
 #include "../include/framework.h"
 #include "../include/controllerActor.h"
+#include "../include/monthLog.h"
+#include "../include/monthRecord.h"
+#include "../include/checkpoint.h"
+#include "../include/ensemble.h"
+#include "../include/benchmark.h"
+#include "../include/landWindow.h"
+#include "../include/landGrid.h"
 #include "../include/config.h"
 #include "../include/actorConfig.h"
 
-int cellWorkers[LENGTH_OF_LAND];
-int popNInf[LENGTH_OF_LAND * 2];
+int * popNInf;      // The (population, infection) pair of every cell of the land
+int * stopPopNInf;  // The cells when the squirrels are stopped, for the land window
 
 int month;
 int remainSquirrel;
@@ -18,28 +26,54 @@ int infectedSquirrel;
 int totalDeadSquirrel;
 int activeSquirrelWorkers;
 int stopSignal;
+long totalSteps;
+
+/** The squirrel actors waiting for the next month, for the step-synchronous months **/
+int * epochPids;
+int epochPidCount;
+int epochSquirrels;
+
+/** The counts the batched squirrel actors add up for the month, for the accounting reduction **/
+MPI_Comm accountComm;
+MPI_Request accountRequest;
+int accountCounts[ACCOUNT_SIZE];
+int epochReduced;
+int leasedBirths;   // The births leased to the batched squirrel actors and not reported yet
 
 MPI_Status status;
 
 /** ========= The functions blow from actor framework, they will be called in framework.c ========= **/
-int controllerAsk(int workerPid);
+void controllerAsk(int index, struct ActorInit * init);
 int initialiseController();
 int controllerWorker();
 /** ========= The functions blow belong to this actor ========= **/
 void sendAllLandCell(int * sendBuffer, int count);
 void sendRecvAllPopNInf(int * sendBuffer, int count);
+void renewAllLandCell();
+void stopSquirrels();
+void stopAllLandCell();
 void countSquirrels();
-void print_log();
+void countAccount(const int * counts);
+void grantLease(int source);
+void reduceSquirrels();
+void startAccount();
+void releaseEpoch(int nextMonth);
+void countSteps();
+void print_log(int last);
+void checkpointController();
+void restoreController();
 
 /**
- * @brief The function for worker asking message from the master.
- * @param[in] workerPid
- * The workers' pids.
+ * @brief Fill the init record of the initial controller.
+ * @param[in] index
+ * The place of the controller in the controllers.
+ * @param[out] init
  *
  */
-int controllerAsk(int workerPid){
-    MPI_Send(cellWorkers, LENGTH_OF_LAND, MPI_INT, workerPid, INITIAL_TAG, MPI_COMM_WORLD);
-    return workerPid;
+void controllerAsk(int index, struct ActorInit * init){
+    (void) index;
+    // The controller knows the land and the batched squirrel actors from the pids every process works out
+    init->identity = CONTROLLER_ACTOR;
 }
 
 /**
@@ -47,7 +81,24 @@ int controllerAsk(int workerPid){
  *
  */
 int initialiseController(){
-    MPI_Recv(cellWorkers, LENGTH_OF_LAND, MPI_INT, 0, INITIAL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    // The communicator of the accounting reduction is split at startup
+    accountComm = actorComm;
+
+    // The arrays are sized by the parameters, which do not change while the process lives
+    if (popNInf == NULL) {
+        popNInf = (int *) malloc(sizeof(int) * LENGTH_OF_LAND * 2);
+        stopPopNInf = (int *) malloc(sizeof(int) * LENGTH_OF_LAND * 2);
+        epochPids = (int *) malloc(sizeof(int) * MAX_SQUIRREL_NUMBER);
+        if (popNInf == NULL || stopPopNInf == NULL || epochPids == NULL) {
+            fprintf(stderr, "[Controller] Can not allocate the arrays of %d cells and %d squirrels\n", LENGTH_OF_LAND, MAX_SQUIRREL_NUMBER);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    if (MONTH_OUTPUT[0] != '\0')
+        openMonthRecords(MONTH_OUTPUT, LENGTH_OF_LAND, MONTH_OUTPUT_CELLS);
+    if (ENSEMBLE_REPLICAS > 1)
+        startEnsembleMonths();
     return 0;
 }
 
@@ -64,21 +115,58 @@ int controllerWorker(){
     totalDeadSquirrel = 0;
     month = 0;
     stopSignal = 0;
+    totalSteps = 0;
+    epochPidCount = 0;
+    epochSquirrels = 0;
+    leasedBirths = 0;
+    if (RESTART_FILE[0] != '\0')
+        restoreController();
 
-    double start, end, duration, commStart, commEnd, commDuration;
+    double start, end, duration, commStart, commEnd, commDuration, runStart;
 
     int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_rank(simComm, &rank);
 
+    runStart = MPI_Wtime();
     start = MPI_Wtime();
-    while(month < MONTH_LIMIT && activeSquirrelWorkers > 0 && activeSquirrelWorkers < MAX_SQUIRREL_NUMBER){
+    startBenchmarkRun();
+    if (ACCOUNTING_REDUCE_MODE)
+        startAccount();
+    // With the accounting reduction the numbers of squirrels are only exact, and checked, at the end of a month
+    while(month < MONTH_LIMIT && ((ACCOUNTING_REDUCE_MODE && !epochReduced) ||
+                                  (activeSquirrelWorkers > 0 && activeSquirrelWorkers < MAX_SQUIRREL_NUMBER))){
+        if (STEP_SYNC_MONTHS) {
+            // The month moves on when every squirrel has made its steps of the month
+            if (ACCOUNTING_REDUCE_MODE ? epochReduced : epochSquirrels == activeSquirrelWorkers) {
+                month++;
+
+                renewAllLandCell();
+                countSteps();
+                markBenchmarkMonth();
+                print_log(0);
+                if (CHECKPOINT_MONTHS && month % CHECKPOINT_MONTHS == 0)
+                    checkpointController();
+                if (month < MONTH_LIMIT)
+                    releaseEpoch(month);
+                continue;
+            }
+
+            if (ACCOUNTING_REDUCE_MODE)
+                reduceSquirrels();
+            else
+                countSquirrels();
+            continue;
+        }
+
         end = MPI_Wtime();
         duration = end - start;
         if (duration > LAND_RENEW_RATE) {
             month++;
 
-            sendRecvAllPopNInf(&month, 1);
-            print_log();
+            renewAllLandCell();
+            countSteps();
+            markBenchmarkMonth();
+            print_log(0);
             start = MPI_Wtime();
             continue;
         }
@@ -90,23 +178,30 @@ int controllerWorker(){
         start += commDuration;
     }
 
-    stopSignal = SQUIRREL_STOP_SIGNAL;  // Let the land actor tell squirrels to stop
-    sendAllLandCell(&stopSignal, 1);
+    stopSquirrels();
+    // The squirrels waiting for the next month stop as well
+    releaseEpoch(SQUIRREL_STOP_SIGNAL);
 
     while (activeSquirrelWorkers) {
         countSquirrels();
     }
 
-    stopSignal = LAND_STOP_SIGNAL;
-    sendRecvAllPopNInf(&stopSignal, 1);
+    stopAllLandCell();
+    countSteps();
+    end = MPI_Wtime();
+    finishBenchmarkRun(totalSteps);
 
-    if (month < 24) {
-        // Print the last output if there is no enough 24 months
-        printf("[Last output]");
-        print_log();
+    if (month < MONTH_LIMIT) {
+        // Print the last output if the simulation stopped before MONTH_LIMIT months
+        print_log(1);
     }
 
+    printf("Squirrel steps %ld in %f s, %.0f steps/s\n", totalSteps, end - runStart, totalSteps / (end - runStart));
     printf("Controller Stop\n");
+    if (MONTH_OUTPUT[0] != '\0')
+        closeMonthRecords();
+    if (ENSEMBLE_REPLICAS > 1)
+        gatherEnsembleMonths();
     shutdownPool();
     return 0;
 }
@@ -121,14 +216,14 @@ int controllerWorker(){
  */
 void sendAllLandCell(int * sendBuffer, int count){
     int i;
-    MPI_Request requestList[LENGTH_OF_LAND];
-    MPI_Status statusList[LENGTH_OF_LAND];
+    MPI_Request requestList[LAND_ACTORS];
+    MPI_Status statusList[LAND_ACTORS];
 
-    for (i=0; i<LENGTH_OF_LAND; i++) {
-        MPI_Isend(sendBuffer, count, MPI_INT, cellWorkers[i], LAND_RECV_TAG, MPI_COMM_WORLD, &requestList[i]);
+    for (i=0; i<LAND_ACTORS; i++) {
+        MPI_Isend(sendBuffer, count, MPI_INT, cellWorkers[i], LAND_RECV_TAG, simComm, &requestList[i]);
     }
 
-    MPI_Waitall(LENGTH_OF_LAND, requestList, statusList);
+    MPI_Waitall(LAND_ACTORS, requestList, statusList);
 }
 
 /**
@@ -142,14 +237,63 @@ void sendAllLandCell(int * sendBuffer, int count){
  */
 void sendRecvAllPopNInf(int * sendBuffer, int count){
     int i;
-    MPI_Request requestList[LENGTH_OF_LAND * 2];
-    MPI_Status statusList[LENGTH_OF_LAND * 2];
-    for (i=0; i<LENGTH_OF_LAND; i++) {
-        MPI_Isend(sendBuffer, count, MPI_INT, cellWorkers[i], LAND_RECV_TAG, MPI_COMM_WORLD, &requestList[i*2]);
-        MPI_Irecv(&popNInf[i*2], 2, MPI_INT, cellWorkers[i], CONTROLLER_RECV_TAG, MPI_COMM_WORLD, &requestList[i*2+1]);
+    MPI_Request requestList[LAND_ACTORS * 2];
+    MPI_Status statusList[LAND_ACTORS * 2];
+    for (i=0; i<LAND_ACTORS; i++) {
+        // Every land replies the pairs of its block of cells
+        MPI_Isend(sendBuffer, count, MPI_INT, cellWorkers[i], LAND_RECV_TAG, simComm, &requestList[i*2]);
+        MPI_Irecv(&popNInf[getLandFirstCell(i) * 2], getLandCellCount(i) * 2, MPI_INT, cellWorkers[i], CONTROLLER_RECV_TAG,
+                  simComm, &requestList[i*2+1]);
+    }
+
+    MPI_Waitall(LAND_ACTORS * 2, requestList, statusList);
+}
+
+/**
+ * @brief Move all the lands to the new month, and get the population influx and infection level
+ * of the month that just finished
+ *
+ */
+void renewAllLandCell(){
+    int i;
+    if (LAND_RMA_MODE) {
+        for (i=0; i<LAND_ACTORS; i++)
+            renewLandWindow(cellWorkers[i], getLandCellCount(i), &popNInf[getLandFirstCell(i) * 2]);
+        return;
+    }
+    sendRecvAllPopNInf(&month, 1);
+}
+
+/**
+ * @brief Let the lands tell squirrels to stop, by the stop signal or by the stop flag in the land window
+ *
+ */
+void stopSquirrels(){
+    int i;
+    stopSignal = SQUIRREL_STOP_SIGNAL;
+    if (LAND_RMA_MODE) {
+        // The cells do not change any more, keep them for the last output
+        for (i=0; i<LAND_ACTORS; i++)
+            stopLandWindow(cellWorkers[i], getLandCellCount(i), &stopPopNInf[getLandFirstCell(i) * 2]);
+        return;
     }
+    sendAllLandCell(&stopSignal, 1);
+}
 
-    MPI_Waitall(LENGTH_OF_LAND, requestList, statusList);
+/**
+ * @brief Stop the lands, and get the population influx and infection level of the current month
+ *
+ */
+void stopAllLandCell(){
+    int i;
+    stopSignal = LAND_STOP_SIGNAL;
+    if (LAND_RMA_MODE) {
+        sendAllLandCell(&stopSignal, 1);
+        for (i=0; i<LENGTH_OF_LAND * 2; i++)
+            popNInf[i] = stopPopNInf[i];
+        return;
+    }
+    sendRecvAllPopNInf(&stopSignal, 1);
 }
 
 /**
@@ -159,48 +303,219 @@ void sendRecvAllPopNInf(int * sendBuffer, int count){
  *
  */
 void countSquirrels(){
-    int squirlSignal;
+    int squirlSignal[ACCOUNT_SIZE + 1], count;
+
+    MPI_Recv(squirlSignal, ACCOUNT_SIZE + 1, MPI_INT, MPI_ANY_SOURCE, SQUIRREL_CONTROLLER_TAG, simComm, &status);
+    MPI_Get_count(&status, MPI_INT, &count);
+    // A batched squirrel actor can report the same signal for several squirrels in one message
+    if (count < 2)
+        squirlSignal[1] = 1;
 
-    MPI_Recv(&squirlSignal, 1, MPI_INT, MPI_ANY_SOURCE, SQUIRREL_CONTROLLER_TAG, MPI_COMM_WORLD, &status);
-    if (squirlSignal == NOT_EXIST) {
+    if (squirlSignal[0] == NOT_EXIST) {
         remainSquirrel--;
         infectedSquirrel--;
         activeSquirrelWorkers--;
         if (stopSignal != SQUIRREL_STOP_SIGNAL)
             // The death is counted if the squirrel is dead before being terminated
             totalDeadSquirrel++;
-    } else if (squirlSignal == BORN){
+    } else if (squirlSignal[0] == BORN){
+        // With the accounting reduction the batched squirrel actor adds the counts it kept so far,
+        // so that the controller decides on the number of squirrels alive right now
+        if (count == ACCOUNT_SIZE + 1)
+            countAccount(&squirlSignal[1]);
         // Check if the number of squirrel out of limit,
         // then decide the squirrel can give birth or not
         if (remainSquirrel < MAX_SQUIRREL_NUMBER && stopSignal != SQUIRREL_STOP_SIGNAL) {
-            squirlSignal = HEALTHY;
+            squirlSignal[0] = HEALTHY;
             remainSquirrel++;
             activeSquirrelWorkers++;
         } else {
-            squirlSignal = NOT_EXIST;
+            squirlSignal[0] = NOT_EXIST;
         }
-        MPI_Send(&squirlSignal, 1, MPI_INT, status.MPI_SOURCE, SQUIRREL_CONTROLLER_TAG, MPI_COMM_WORLD);
-    } else if (squirlSignal == CATCH_DISEASE) {
+        MPI_Send(squirlSignal, 1, MPI_INT, status.MPI_SOURCE, SQUIRREL_CONTROLLER_TAG, simComm);
+    } else if (squirlSignal[0] == LEASE) {
+        // The births of the lease so far come with the other counts
+        countAccount(&squirlSignal[1]);
+        grantLease(status.MPI_SOURCE);
+    } else if (squirlSignal[0] == CATCH_DISEASE) {
         infectedSquirrel++;
-    } else if (squirlSignal == TERMINATE) {
-        activeSquirrelWorkers--;
+    } else if (squirlSignal[0] == TERMINATE) {
+        activeSquirrelWorkers -= squirlSignal[1];
+    } else if (squirlSignal[0] == EPOCH_DONE) {
+        // The squirrels have made all their steps of the month and wait for the next one
+        if (stopSignal == SQUIRREL_STOP_SIGNAL) {
+            squirlSignal[0] = SQUIRREL_STOP_SIGNAL;
+            MPI_Send(squirlSignal, 1, MPI_INT, status.MPI_SOURCE, EPOCH_TAG, simComm);
+        } else {
+            epochPids[epochPidCount++] = status.MPI_SOURCE;
+            epochSquirrels += squirlSignal[1];
+        }
+    }
+}
+
+/**
+ * @brief Count the deaths, the squirrels catching disease and the births of the lease a batched squirrel actor
+ * kept, the same as one NOT_EXIST, CATCH_DISEASE or permitted BORN signal each. The births of the lease that are
+ * used or returned are not held back any more.
+ * @param[in] counts
+ * The counts indexed by ACCOUNT_DIED, ACCOUNT_CAUGHT, ACCOUNT_BORN and ACCOUNT_RETURNED
+ *
+ */
+void countAccount(const int * counts){
+    remainSquirrel += counts[ACCOUNT_BORN] - counts[ACCOUNT_DIED];
+    infectedSquirrel += counts[ACCOUNT_CAUGHT] - counts[ACCOUNT_DIED];
+    activeSquirrelWorkers += counts[ACCOUNT_BORN] - counts[ACCOUNT_DIED];
+    leasedBirths -= counts[ACCOUNT_BORN] + counts[ACCOUNT_RETURNED];
+    if (stopSignal != SQUIRREL_STOP_SIGNAL)
+        totalDeadSquirrel += counts[ACCOUNT_DIED];
+}
+
+/**
+ * @brief Lease births to a batched squirrel actor, at most BIRTH_LEASE_SIZE and at most a fair share of the room
+ * left under MAX_SQUIRREL_NUMBER, so near the limit the first actor to ask does not take all the room. The leased
+ * births are held back from the room until they are reported or returned at the end of the month, so the squirrels
+ * can not be more than MAX_SQUIRREL_NUMBER whoever uses them.
+ * @param[in] source
+ * The pid of the batched squirrel actor
+ *
+ */
+void grantLease(int source){
+    int room = MAX_SQUIRREL_NUMBER - remainSquirrel - leasedBirths, births;
+
+    births = room / SQUIRREL_BATCH_ACTORS;
+    if (births < 1)
+        births = 1;
+    if (births > BIRTH_LEASE_SIZE)
+        births = BIRTH_LEASE_SIZE;
+    if (births > room)
+        births = room;
+    if (births < 0 || stopSignal == SQUIRREL_STOP_SIGNAL)
+        births = 0;
+
+    leasedBirths += births;
+    MPI_Send(&births, 1, MPI_INT, source, LEASE_TAG, simComm);
+}
+
+/**
+ * @brief Handle a message of the squirrels if there is one, otherwise check whether the accounting
+ * reduction of the month is done. The month is done when every batched squirrel actor has added its counts.
+ *
+ */
+void reduceSquirrels(){
+    int flag;
+
+    MPI_Iprobe(MPI_ANY_SOURCE, SQUIRREL_CONTROLLER_TAG, simComm, &flag, MPI_STATUS_IGNORE);
+    if (flag) {
+        countSquirrels();
+        return;
     }
+
+    MPI_Test(&accountRequest, &epochReduced, MPI_STATUS_IGNORE);
+    if (epochReduced)
+        countAccount(accountCounts);
 }
 
 /**
- * @brief Print the population and infection level in current month
+ * @brief Start the accounting reduction of a month, the controller adds nothing to it
  *
  */
-void print_log(){
+void startAccount(){
     int i;
-    printf("Month %2d\talive %d\tinfected %d\tdead %d\n", month, remainSquirrel, infectedSquirrel, totalDeadSquirrel);
-    printf("POPULATION INFLUX\t[\t");
-    for (i=0; i<LENGTH_OF_LAND; i++)
-        printf("%d\t", popNInf[i*2]);
-    printf("]\n");
+    for (i=0; i<ACCOUNT_SIZE; i++)
+        accountCounts[i] = 0;
+
+    epochReduced = 0;
+    MPI_Ireduce(MPI_IN_PLACE, accountCounts, ACCOUNT_SIZE, MPI_INT, MPI_SUM, 0, accountComm, &accountRequest);
+}
+
+/**
+ * @brief Let the squirrel actors waiting at the end of the month go on
+ * @param[in] nextMonth
+ * The month to go on to, or SQUIRREL_STOP_SIGNAL to stop the squirrels
+ *
+ */
+void releaseEpoch(int nextMonth){
+    int i;
+    if (ACCOUNTING_REDUCE_MODE) {
+        // Every batched squirrel actor waits on the broadcast, then reports the next month
+        MPI_Bcast(&nextMonth, 1, MPI_INT, 0, accountComm);
+        if (nextMonth != SQUIRREL_STOP_SIGNAL)
+            startAccount();
+        return;
+    }
+
+    for (i=0; i<epochPidCount; i++)
+        MPI_Send(&nextMonth, 1, MPI_INT, epochPids[i], EPOCH_TAG, simComm);
+
+    epochPidCount = 0;
+    epochSquirrels = 0;
+}
 
-    printf("INFECTION  LEVEL \t[\t");
+/**
+ * @brief Write the checkpoint of the month that just finished. The lands and the batched squirrel actors wait
+ * for the next month, they are told to write their part of it with the checkpoint signal.
+ *
+ */
+void checkpointController(){
+    int checkpointSignal = CHECKPOINT_SIGNAL;
+    int64_t header[CHECKPOINT_HEADER_FIELDS];
+
+    sendAllLandCell(&checkpointSignal, 1);
+    MPI_Bcast(&checkpointSignal, 1, MPI_INT, 0, accountComm);
+
+    header[CHECKPOINT_ALIVE] = remainSquirrel;
+    header[CHECKPOINT_INFECTED] = infectedSquirrel;
+    header[CHECKPOINT_DEAD] = totalDeadSquirrel;
+    header[CHECKPOINT_STEPS] = totalSteps;
+    writeCheckpoint(month, header, 0, 0, NULL, NULL, NULL);
+}
+
+/**
+ * @brief Go on from the month and the squirrel counts of the checkpoint RESTART_FILE. The batched squirrel actors
+ * returned their leases before the checkpoint, and ask for new ones when the month starts.
+ *
+ */
+void restoreController(){
+    int64_t header[CHECKPOINT_HEADER_FIELDS];
+
+    readCheckpointHeader(RESTART_FILE, header);
+    month = (int) header[CHECKPOINT_MONTH];
+    remainSquirrel = (int) header[CHECKPOINT_ALIVE];
+    activeSquirrelWorkers = (int) header[CHECKPOINT_ALIVE];
+    infectedSquirrel = (int) header[CHECKPOINT_INFECTED];
+    totalDeadSquirrel = (int) header[CHECKPOINT_DEAD];
+    totalSteps = (long) header[CHECKPOINT_STEPS];
+}
+
+/**
+ * @brief Add the population influx the lands reported to the number of squirrel steps,
+ * every squirrel step is one visit of a land cell
+ *
+ */
+void countSteps(){
+    int i;
     for (i=0; i<LENGTH_OF_LAND; i++)
-        printf("%d\t", popNInf[i*2+1]);
-    printf("]\n\n");
+        totalSteps += popNInf[i*2];
+}
+
+/**
+ * @brief Print the population and infection level in current month, or write them to the binary month output
+ * without waiting for the file. The replicas of an ensemble keep their months for the statistics of the
+ * ensemble instead of printing them.
+ * @param[in] last
+ * 1 if the simulation stopped before the last month
+ *
+ */
+void print_log(int last){
+    if (ENSEMBLE_REPLICAS > 1 && !last)
+        recordEnsembleMonth(month, remainSquirrel, infectedSquirrel, totalDeadSquirrel);
+    if (MONTH_OUTPUT[0] != '\0') {
+        writeMonthRecord(month, remainSquirrel, infectedSquirrel, totalDeadSquirrel, last, popNInf);
+        return;
+    }
+    if (ENSEMBLE_REPLICAS > 1)
+        return;
+    if (last)
+        printf("[Last output]");
+    printMonthLog(month, remainSquirrel, infectedSquirrel, totalDeadSquirrel, popNInf, LENGTH_OF_LAND);
 }
@@ -0,0 +1,136 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#include "../include/ensemble.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+
+/** The counts of the months of this replica, -1 for the months it did not get to **/
+static int * ensembleMonths;
+
+static void printEnsembleCount(const char * name, int * records, int replicas, int months, int month, int count);
+
+/**
+ * @brief Start keeping the months of this replica, the controller calls it before its first month
+ *
+ */
+void startEnsembleMonths(){
+    int i;
+
+    free(ensembleMonths);
+    ensembleMonths = (int *) malloc(sizeof(int) * (MONTH_LIMIT + 1) * ENSEMBLE_COUNTS);
+    if (ensembleMonths == NULL) {
+        fprintf(stderr, "[Ensemble] Can not allocate the counts of %d months\n", MONTH_LIMIT);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (i=0; i<(MONTH_LIMIT + 1) * ENSEMBLE_COUNTS; i++)
+        ensembleMonths[i] = -1;
+}
+
+/**
+ * @brief Keep the squirrel counts of a month of this replica
+ * @param[in] month
+ * @param[in] alive
+ * @param[in] infected
+ * @param[in] dead
+ *
+ */
+void recordEnsembleMonth(int month, int alive, int infected, int dead){
+    if (month < 0 || month > MONTH_LIMIT)
+        return;
+    ensembleMonths[month * ENSEMBLE_COUNTS + ENSEMBLE_ALIVE] = alive;
+    ensembleMonths[month * ENSEMBLE_COUNTS + ENSEMBLE_INFECTED] = infected;
+    ensembleMonths[month * ENSEMBLE_COUNTS + ENSEMBLE_DEAD] = dead;
+}
+
+/**
+ * @brief Gather the months of all the replicas to the controller of replica 0, which prints their statistics.
+ * It is collective over ensembleComm, so every controller calls it when its replica stops. The replicas can have
+ * different MONTH_LIMITs, the months are gathered up to the largest one.
+ *
+ */
+void gatherEnsembleMonths(){
+    int i, rank, replicas, months, * records, * sent;
+
+    MPI_Comm_rank(ensembleComm, &rank);
+    MPI_Comm_size(ensembleComm, &replicas);
+    MPI_Allreduce(&MONTH_LIMIT, &months, 1, MPI_INT, MPI_MAX, ensembleComm);
+
+    sent = (int *) malloc(sizeof(int) * (months + 1) * ENSEMBLE_COUNTS);
+    records = (int *) malloc(sizeof(int) * (months + 1) * ENSEMBLE_COUNTS * (rank == 0 ? replicas : 1));
+    if (sent == NULL || records == NULL) {
+        fprintf(stderr, "[Ensemble] Can not allocate the counts of %d replicas\n", replicas);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (i=0; i<(months + 1) * ENSEMBLE_COUNTS; i++)
+        sent[i] = i < (MONTH_LIMIT + 1) * ENSEMBLE_COUNTS ? ensembleMonths[i] : -1;
+
+    MPI_Gather(sent, (months + 1) * ENSEMBLE_COUNTS, MPI_INT, records, (months + 1) * ENSEMBLE_COUNTS, MPI_INT, 0,
+               ensembleComm);
+
+    if (rank == 0) {
+        printf("Ensemble of %d replicas\n", replicas);
+        for (i=1; i<=months; i++) {
+            printf("Month %2d", i);
+            printEnsembleCount("alive", records, replicas, months, i, ENSEMBLE_ALIVE);
+            printEnsembleCount("infected", records, replicas, months, i, ENSEMBLE_INFECTED);
+            printEnsembleCount("dead", records, replicas, months, i, ENSEMBLE_DEAD);
+            printf("\n");
+        }
+    }
+
+    free(sent);
+    free(records);
+    free(ensembleMonths);
+    ensembleMonths = NULL;
+}
+
+/**
+ * @brief Print the mean, the standard deviation, the minimum and the maximum of a count of a month over the
+ * replicas that got to the month, and how many they are
+ * @param[in] name
+ * @param[in] records
+ * The months of every replica, one after another
+ * @param[in] replicas
+ * @param[in] months
+ * The months of a replica in the records
+ * @param[in] month
+ * @param[in] count
+ * The ENSEMBLE_ count
+ *
+ */
+static void printEnsembleCount(const char * name, int * records, int replicas, int months, int month, int count){
+    int i, value, min, max, n;
+    double sum, squares, mean;
+
+    n = 0;
+    sum = squares = 0;
+    min = max = 0;
+    for (i=0; i<replicas; i++) {
+        value = records[(i * (months + 1) + month) * ENSEMBLE_COUNTS + count];
+        if (value < 0)
+            continue;
+        if (n == 0 || value < min)
+            min = value;
+        if (n == 0 || value > max)
+            max = value;
+        sum += value;
+        squares += (double) value * value;
+        n++;
+    }
+
+    if (count == ENSEMBLE_ALIVE)
+        printf("\treplicas %d", n);
+    if (n == 0) {
+        printf("\t%s -", name);
+        return;
+    }
+    mean = sum / n;
+    printf("\t%s %.1f sd %.1f [%d, %d]", name, mean, sqrt(squares / n - mean * mean > 0 ? squares / n - mean * mean : 0),
+           min, max);
+}
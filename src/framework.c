@@ -3,6 +3,8 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <mpi.h>
 
@@ -10,82 +12,110 @@
 #include "../include/framework.h"
 #include "../include/actorConfig.h"
 #include "../include/landActor.h"
+#include "../include/landWindow.h"
 #include "../include/squirrelActor.h"
+#include "../include/squirrelBatchActor.h"
 #include "../include/controllerActor.h"
+#include "../include/benchmark.h"
+#include "../include/mpiProfile.h"
+#include "../include/trace.h"
+#include "../include/latency.h"
 
-static int masterInitialiseWorker(int identity);
-static void masterInitialiseWorkers(int identity, int count, int * workerPids);
-static void masterInitialiseVariables();
-static void masterSendWorkers(int count, int workerPids[], WorkerFunc workerAskFunc);
+static void shareSimConfig(int argc, char* argv[], int rank);
+static void splitEnsemble(int rank, int size);
+static void addReplicaSuffix(char * path, int replica);
+static int * allocatePids(int count);
+static void createActorInitType();
+static int planActors(int rank);
+static void splitActorComm(int index);
+static void initialActorInit(int index, struct ActorInit * init);
 static void masterCode();
-static void workerCode(WorkerFunc initialiseFunc, WorkerFunc workerFunc);
-
-/**
- * @brief Here is the global variables that need to be initialised in the framework
- *
- */
-static void masterInitialiseVariables() {
-    sickCount = 0;
-}
+static void workerCode(int initialIndex);
 
 int main(int argc, char* argv[]) {
-    // Call MPI initialize first
-    MPI_Init(&argc, &argv);
+    // Call MPI initialize first. Only the main thread makes MPI calls, the threads of the batched squirrel actors
+    // step the squirrels between them
+    int rank, size, provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
-    int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+    // Every process runs the simulation of the master's parameters, or the one of its replica in an ensemble
+    shareSimConfig(argc, argv, rank);
+    splitEnsemble(rank, size);
+    MPI_Comm_rank(simComm, &rank);
+    if ((SQUIRREL_THREADS > 1 || LAND_THREADS > 1) && provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0)
+            fprintf(stderr, "[Framework] The threads need MPI_THREAD_FUNNELED, the MPI library gives %d\n", provided);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    // The benchmark counts the messages of the profile
+    startMpiProfile(MPI_PROFILE || BENCHMARK_OUTPUT[0] != '\0');
+    startTrace(TRACE_OUTPUT[0] != '\0', TRACE_EVENTS);
+    startLatencyHistograms(LATENCY_HISTOGRAMS);
+    cellWorkers = allocatePids(LAND_ACTORS);
+    squirrelBatchWorkers = allocatePids(SQUIRREL_BATCH_ACTORS);
+    createActorInitType();
+
+    // Every process works out where the initial actors run, so they start without a message from the master
+    processPoolSetComm(simComm);
+    int initialIndex = planActors(rank);
+    splitActorComm(initialIndex);
+
+    // The window of the land cells is collective, so it is created before the workers go to the pool
+    if (LAND_RMA_MODE)
+        createLandWindow();
 
     /*
      * Initialise the process pool.
      * The return code is = 1 for worker to do some work, 0 for do nothing and stop and 2 for this is the master so call master poll
      * For workers this subroutine will block until the master has woken it up to do some work
      */
+    double sleep = traceBegin();
     int statusCode = processPoolInit();
 
     if (statusCode == 1) {
-        int identity;
-        MPI_Recv(&identity, 1, MPI_INT, MPI_ANY_SOURCE, IDENTITY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-        switch (identity){
-            case CONTROLLER_ACTOR:
-                workerCode(initialiseController, controllerWorker);
-                break;
-            case LAND_ACTOR:
-                workerCode(initialiseLandCell, landWorker);
-                break;
-            case SQUIRREL_ACTOR:
-                workerCode(initialiseSquirrel, squirrelWorker);
-                break;
-        }
-
+        // The workers that are not initial actors sleep in the pool until they are woken
+        traceEnd(TRACE_SLEEP, sleep);
+        workerCode(initialIndex);
     } else if (statusCode == 2) {
         masterCode();
     }
 
     // Finalizes the process pool, call this before closing down MPI
     processPoolFinalise();
+    if (MPI_PROFILE)
+        printMpiProfile();
+    if (LATENCY_HISTOGRAMS)
+        printLatencyHistograms();
+    if (BENCHMARK_OUTPUT[0] != '\0')
+        writeBenchmark(BENCHMARK_OUTPUT, controllers[0]);
+    if (TRACE_OUTPUT[0] != '\0')
+        writeTrace(TRACE_OUTPUT);
+    if (LAND_RMA_MODE)
+        freeLandWindow();
+    if (actorComm != MPI_COMM_NULL)
+        MPI_Comm_free(&actorComm);
+    if (checkpointComm != MPI_COMM_NULL)
+        MPI_Comm_free(&checkpointComm);
+    if (ensembleComm != MPI_COMM_NULL)
+        MPI_Comm_free(&ensembleComm);
+    if (simComm != MPI_COMM_WORLD)
+        MPI_Comm_free(&simComm);
+    free(cellWorkers);
+    free(squirrelBatchWorkers);
+    MPI_Type_free(&actorInitType);
     // Finalize MPI, ensure you have closed the process pool first
     MPI_Finalize();
     return 0;
 }
 
 /**
- * @brief The master process code. It should be a structure like this
+ * @brief The master process code. The initial actors are awake when the pool starts, so the master only
+ * serves the pool:
  * @example
  *
- *     masterInitialiseVariables();  // Initialise the variables
- *
- *     masterInitialiseWorkers(WORKER1, n1, worker1Pids);  // Initialise the workers 1
- *     masterInitialiseWorkers(WORKER2, n2, worker2Pids);  // Initialise the workers 2
- *     ...
- *
- *     masterSendWorkers(n1, worker1Pids, worker1AskFunc);  // Response workers 1 ask
- *     masterSendWorkers(n2, worker2Pids, worker2AskFunc);  // Response workers 2 ask
- *     ...
- *
  *     int masterStatus = masterPoll();
  *     while (masterStatus) {
  *         masterStatus=masterPoll();
@@ -94,20 +124,6 @@ int main(int argc, char* argv[]) {
  *
  */
 static void masterCode() {
-    masterInitialiseVariables();
-    // Initial controller
-    masterInitialiseWorkers(CONTROLLER_ACTOR, CONTROLLER_NUMBER, controllers);
-    // Initial land actors
-    masterInitialiseWorkers(LAND_ACTOR, LENGTH_OF_LAND, cellWorkers);
-    // Initial squirrel actors
-    masterInitialiseWorkers(SQUIRREL_ACTOR, INITIAL_NUMBER_OF_SQUIRRELS, squirrelWorkers);
-    // Response controller's ask
-    masterSendWorkers(CONTROLLER_NUMBER, controllers, controllerAsk);
-    // Response lands' ask
-    masterSendWorkers(LENGTH_OF_LAND, cellWorkers, landAsk);
-    // Response squirrels' ask
-    masterSendWorkers(INITIAL_NUMBER_OF_SQUIRRELS, squirrelWorkers, squirrelAsk);
-
     double start, end;
     start = MPI_Wtime();
 
@@ -120,75 +136,261 @@ static void masterCode() {
     printf("Master Quit. Runtime %f s\n", end-start);
 }
 
+/**
+ * @brief The master reads the parameters of the simulation from its command line and sends them to every
+ * process, so the config file only needs to be readable by the master. The processes run one binary on
+ * one kind of machine, so the parameters are sent as bytes.
+ * @param[in] argc
+ * @param[in] argv
+ * @param[in] rank
+ *
+ */
+static void shareSimConfig(int argc, char* argv[], int rank){
+    if (rank == 0 && readSimConfig(argc, argv)) {
+        fprintf(stderr, "Usage: %s [-c file] [NAME=value ...], the names are the parameters in config.h\n", argv[0]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Bcast(&simConfig, sizeof(struct SimConfig), MPI_BYTE, 0, MPI_COMM_WORLD);
+}
 
 /**
- * @brief The master initialise 1 worker
- * @param[in] identity
- * The worker's Identity, to define what kinds of actor is the worker.
+ * @brief Split MPI_COMM_WORLD into the ENSEMBLE_REPLICAS replicas of an ensemble, in blocks of ranks in order.
+ * Every replica runs its own pool and actors with the seed SQUIRREL_RNG_SEED + replica, and its master reads
+ * ENSEMBLE_CONFIG.<replica> over the shared parameters if it is set. The months, the checkpoints, the benchmark and
+ * the trace of a replica go to its own files, and it restarts from its own checkpoint. Without an ensemble the
+ * simulation runs in MPI_COMM_WORLD.
+ * @param[in] rank
+ * @param[in] size
+ * The rank and size in MPI_COMM_WORLD
  *
  */
-static int masterInitialiseWorker(int identity){
-    // Initial controller
-    int workerPid = startWorkerProcess();
-    // Tell the process that it is a controller
-    MPI_Send(&identity, 1, MPI_INT, workerPid, IDENTITY_TAG, MPI_COMM_WORLD);
-    return workerPid;
+static void splitEnsemble(int rank, int size){
+    int replicas = ENSEMBLE_REPLICAS;
+    char path[sizeof(simConfig.ensembleConfig) + 16];
+
+    ensembleReplica = 0;
+    if (replicas == 1) {
+        simComm = MPI_COMM_WORLD;
+        return;
+    }
+
+    ensembleReplica = (int) ((long) rank * replicas / size);
+    MPI_Comm_split(MPI_COMM_WORLD, ensembleReplica, rank, &simComm);
+
+    MPI_Comm_rank(simComm, &rank);
+    if (rank == 0) {
+        simConfig.squirrelRngSeed += ensembleReplica;
+        addReplicaSuffix(MONTH_OUTPUT, ensembleReplica);
+        addReplicaSuffix(RESTART_FILE, ensembleReplica);
+        addReplicaSuffix(BENCHMARK_OUTPUT, ensembleReplica);
+        addReplicaSuffix(TRACE_OUTPUT, ensembleReplica);
+        if (ENSEMBLE_CONFIG[0] != '\0') {
+            snprintf(path, sizeof(path), "%s.%d", ENSEMBLE_CONFIG, ensembleReplica);
+            if (readReplicaConfig(path))
+                MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        // The replicas have to agree on the ensemble whatever their config files say
+        simConfig.ensembleReplicas = replicas;
+    }
+    MPI_Bcast(&simConfig, sizeof(struct SimConfig), MPI_BYTE, 0, simComm);
 }
 
 /**
- * @brief The master initialise a brunch of workers
- * @param[in] identity
- * The worker's Identity, to define what kinds of actor are the workers.
- * @param[in] count
- * The number of this brunch of workers
- * @param[out] workerPids
- * The statics array that records the workers' pids.
+ * @brief Add the replica to a path of the parameters, so the replicas of an ensemble write their own files
+ * @param[in,out] path
+ * The path in the parameters, it is left empty if it is not set
+ * @param[in] replica
  *
  */
-static void masterInitialiseWorkers(int identity, int count, int workerPids[]){
-    int i;
-    for (i=0;i<count;i++) {
-        int workerPid = masterInitialiseWorker(identity);
-        workerPids[i] = workerPid;
+static void addReplicaSuffix(char * path, int replica){
+    char suffix[16];
+    if (path[0] == '\0')
+        return;
+
+    snprintf(suffix, sizeof(suffix), ".%d", replica);
+    if (strlen(path) + strlen(suffix) >= sizeof(simConfig.monthOutput)) {
+        fprintf(stderr, "[Framework] The path %s of replica %d is too long\n", path, replica);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    strcat(path, suffix);
 }
 
 /**
- * @brief The master response what workers' ask
+ * @brief Allocate an array of count pids
  * @param[in] count
- * The number of this brunch of workers
- * @param[in] workerPids
- * The workers' pids.
- * @param[in] workerAskFunc
- * Functon pointer that should be implemented in Actor themselves.
- * The Function should be like: workerAskFunc(int pid)
+ * @return The array, it is never NULL
  *
  */
-static void masterSendWorkers(int count, int workerPids[], WorkerFunc workerAskFunc){
-    int i, workerPid;
-    for (i=0;i<count;i++) {
-        workerAskFunc(workerPids[i]);
+static int * allocatePids(int count){
+    // Ask for one element at least so that an empty array is not NULL
+    int * pids = (int *) malloc(sizeof(int) * (count > 0 ? count : 1));
+    if (pids == NULL) {
+        fprintf(stderr, "[Framework] Can not allocate the pids of %d workers\n", count);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    return pids;
 }
 
 /**
- * @brief The worker code
- * @param[in] initialiseFunc
- * The initialise function that the worker should be done.
- * The function should be implemented in Actor themselves
- * @param[in] workerFunc
- * The worker running function on which the worker actual work.
- * The function should be implemented in Actor themselves
+ * @brief Build the MPI datatype of struct ActorInit, so that the record goes in one message
  *
  */
-static void workerCode(WorkerFunc initialiseFunc, WorkerFunc workerFunc) {
+static void createActorInitType(){
+    struct ActorInit init;
+    MPI_Datatype structType;
+    MPI_Datatype types[3] = {MPI_INT, MPI_UINT64_T, MPI_FLOAT};
+    int blockLengths[3] = {7, 1, 2};
+    MPI_Aint displacements[3], base;
+
+    // identity, state, monthSteps, month and block are 7 ints in a row
+    MPI_Get_address(&init, &base);
+    MPI_Get_address(&init.identity, &displacements[0]);
+    MPI_Get_address(&init.id, &displacements[1]);
+    MPI_Get_address(&init.coord, &displacements[2]);
+    displacements[0] -= base;
+    displacements[1] -= base;
+    displacements[2] -= base;
+
+    MPI_Type_create_struct(3, blockLengths, displacements, types, &structType);
+    MPI_Type_create_resized(structType, 0, sizeof(struct ActorInit), &actorInitType);
+    MPI_Type_commit(&actorInitType);
+    MPI_Type_free(&structType);
+}
+
+/**
+ * @brief Send the record an actor is started with, in one message
+ * @param[in] init
+ * The record, its identity says what kind of actor the worker is
+ * @param[in] workerPid
+ *
+ */
+void sendActorInit(struct ActorInit * init, int workerPid){
+    MPI_Send(init, 1, actorInitType, workerPid, INITIAL_TAG, simComm);
+}
+
+/**
+ * @brief Lay the initial actors out on the workers that are awake when the pool starts, in the order controller,
+ * land actors, then batched squirrel actors or squirrel actors. Every process works the layout out the same way
+ * from the parameters and the pool, so the pids of the controller, the land actors and the batched squirrel
+ * actors need no message. Collective over all the processes of the simulation.
+ * @param[in] rank
+ * @return The place of this process in the initial actors, or -1 if it is not one of them
+ *
+ */
+static int planActors(int rank){
+    int i, count, index;
+
+    count = CONTROLLER_NUMBER + LAND_ACTORS + (SQUIRREL_BATCH_ACTORS > 0 ? SQUIRREL_BATCH_ACTORS : INITIAL_NUMBER_OF_SQUIRRELS);
+    processPoolPlan(count);
+
+    index = -1;
+    for (i=0; i<count; i++)
+        if (getAwakeWorkerRank(i) == rank)
+            index = i;
+
+    for (i=0; i<CONTROLLER_NUMBER; i++)
+        controllers[i] = getAwakeWorkerRank(i);
+    for (i=0; i<LAND_ACTORS; i++)
+        cellWorkers[i] = getAwakeWorkerRank(CONTROLLER_NUMBER + i);
+    for (i=0; i<SQUIRREL_BATCH_ACTORS; i++)
+        squirrelBatchWorkers[i] = getAwakeWorkerRank(CONTROLLER_NUMBER + LAND_ACTORS + i);
+    return index;
+}
+
+/**
+ * @brief Split the communicators of the actors in collectives over all the processes of the simulation. The land
+ * actors get one in the order of cellWorkers. With the accounting reduction the controller and the batched squirrel
+ * actors get one, the controller is its rank 0. With checkpoints all the initial actors get one to write them.
+ * With an ensemble the controllers of all the replicas get one, collective over MPI_COMM_WORLD.
+ * @param[in] index
+ * The place of this process in the initial actors, or -1
+ *
+ */
+static void splitActorComm(int index){
+    int color = MPI_UNDEFINED;
+
+    if (index >= CONTROLLER_NUMBER && index < CONTROLLER_NUMBER + LAND_ACTORS)
+        color = LAND_ACTOR;
+    else if (index >= 0 && ACCOUNTING_REDUCE_MODE)  // The other initial actors are batched squirrel actors then
+        color = CONTROLLER_ACTOR;
+
+    MPI_Comm_split(simComm, color, index, &actorComm);
+
+    checkpointComm = MPI_COMM_NULL;
+    if (CHECKPOINT_MONTHS)
+        MPI_Comm_split(simComm, index >= 0 ? 0 : MPI_UNDEFINED, index, &checkpointComm);
+
+    // The controllers of the replicas, in the order of the replicas
+    ensembleComm = MPI_COMM_NULL;
+    if (ENSEMBLE_REPLICAS > 1)
+        MPI_Comm_split(MPI_COMM_WORLD, index == 0 ? 0 : MPI_UNDEFINED, ensembleReplica, &ensembleComm);
+}
+
+/**
+ * @brief Build the init record of an initial actor, each kind of actor fills in its own part
+ * @param[in] index
+ * The place of the actor in the initial actors
+ * @param[out] init
+ *
+ */
+static void initialActorInit(int index, struct ActorInit * init){
+    struct ActorInit empty = {0};
+
+    *init = empty;
+    if (index < CONTROLLER_NUMBER)
+        controllerAsk(index, init);
+    else if (index < CONTROLLER_NUMBER + LAND_ACTORS)
+        landAsk(index - CONTROLLER_NUMBER, init);
+    else if (SQUIRREL_BATCH_ACTORS > 0)
+        squirrelBatchAsk(index - CONTROLLER_NUMBER - LAND_ACTORS, init);
+    else
+        squirrelAsk(index - CONTROLLER_NUMBER - LAND_ACTORS, init);
+}
+
+/**
+ * @brief The worker code. An initial actor builds its own init record the first time, afterwards each time the
+ * worker is woken it takes the init record from the parent squirrel that started it. It runs the actor the
+ * record says.
+ * @param[in] initialIndex
+ * The place of this process in the initial actors, or -1
+ *
+ */
+static void workerCode(int initialIndex) {
     int workerStatus = 1;
+    double span;
     while (workerStatus) {
-        // Initialise worker
-        initialiseFunc();
-        // Worker do work
-        workerFunc();
+        if (initialIndex >= 0) {
+            initialActorInit(initialIndex, &actorInit);
+            initialIndex = -1;
+        } else {
+            MPI_Recv(&actorInit, 1, actorInitType, getCommandData(), INITIAL_TAG, simComm, MPI_STATUS_IGNORE);
+        }
+
+        setMpiProfileRole(actorInit.identity);
+        span = traceBegin();
+        switch (actorInit.identity){
+            case CONTROLLER_ACTOR:
+                initialiseController();
+                controllerWorker();
+                break;
+            case LAND_ACTOR:
+                initialiseLandCell();
+                landWorker();
+                break;
+            case SQUIRREL_ACTOR:
+                initialiseSquirrel();
+                squirrelWorker();
+                break;
+            case SQUIRREL_BATCH_ACTOR:
+                initialiseSquirrelBatch();
+                squirrelBatchWorker();
+                break;
+        }
+        traceEnd(actorInit.identity, span);
         // This MPI process will sleep, further workers may be run on this process now
+        setMpiProfileRole(PROFILE_POOL);
+        span = traceBegin();
         workerStatus=workerSleep();
+        traceEnd(TRACE_SLEEP, span);
     }
 }
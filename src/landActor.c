@@ -3,43 +3,66 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <mpi.h>
 #include "../include/framework.h"
 #include "../include/landActor.h"
+#include "../include/landGrid.h"
+#include "../include/checkpoint.h"
+#include "../include/trace.h"
+#include "../include/ring.h"
 #include "../include/config.h"
 #include "../include/actorConfig.h"
 
 int controllerWorkerPid;
-int cellWorkers[LENGTH_OF_LAND];
-int population[LAST_POPULATION_MONTHS];
-int infection[LAST_INFECTION_MONTHS];
-int squirlState;
-int sendBuffer[2];
-MPI_Group landGroup;
+int landIndex;  // The place of this land in the land actors, it decides the block of cells the land owns
+int cells;      // The number of cells the land owns
+int * population;  // The months of the cell with offset i start at i * LAST_POPULATION_MONTHS
+int * infection;   // The months of the cell with offset i start at i * LAST_INFECTION_MONTHS
+int * populationSum;  // The running sum of population of each cell
+int * infectionSum;   // The running sum of infection of each cell
+int * sendBuffer;     // The (population, infection) pair of each cell for the controller
+int startMonth;       // The month the land starts in, the month of the checkpoint on a restart
 MPI_Comm landComm;
 MPI_Status status;
 
+/** The ring of preposted persistent receives, every slot can hold the largest batched visit message **/
+int recvBuffers[LAND_RECV_SLOTS][LAND_BATCH_VISITS * 2];
+MPI_Request recvRequests[LAND_RECV_SLOTS];
+MPI_Status recvStatus[LAND_RECV_SLOTS];
+int recvDone[LAND_RECV_SLOTS];
+/** The ring of non-blocking replies to squirrels, and the persistent reply to the controller **/
+int replyBuffers[LAND_REPLY_SLOTS][LAND_BATCH_VISITS * 2];
+MPI_Request replyRequests[LAND_REPLY_SLOTS];
+int replySlot;
+MPI_Request controllerReplyRequest;
+
 /** ========= The functions blow from actor framework, they will be called in framework.c ========= **/
-int landAsk(int workerPid);
+void landAsk(int index, struct ActorInit * init);
 int initialiseLandCell();
 int landWorker();
 /** ========= The functions blow belong to this actor ========= **/
 void landInitialiseMessage();
-void updateLand(int month, MPI_Status status);
-void terminateSquirrel(MPI_Status status);
+void startLandRequests();
+void finishLandRequests();
+int * nextReplyBuffer();
+void replyController(int month);
+void updateLand(int month, int source, int * visits, int count);
+void terminateSquirrel(int source);
 void renewMonth(int month);
+void restoreLand();
 
 /**
- * @brief The function for worker asking message from the master.
- * @param[in] workerPid
- * The workers' pids.
+ * @brief Fill the init record of an initial land actor.
+ * @param[in] index
+ * The place of the land in the land actors.
+ * @param[out] init
  *
  */
-int landAsk(int workerPid) {
-    MPI_Send(&controllers[0], 1, MPI_INT, workerPid, INITIAL_TAG, MPI_COMM_WORLD);
-    // Send the message to tell the land's pids to all land actors for create group communicators.
-    MPI_Send(cellWorkers, LENGTH_OF_LAND, MPI_INT, workerPid, INITIAL_TAG, MPI_COMM_WORLD);
-    return workerPid;
+void landAsk(int index, struct ActorInit * init) {
+    (void) index;
+    // The land knows the controller and the other land actors from the pids every process works out
+    init->identity = LAND_ACTOR;
 }
 
 /**
@@ -49,125 +72,276 @@ int landAsk(int workerPid) {
 int initialiseLandCell(){
     landInitialiseMessage();
 
-    int i;
-    // Initialise population
-    for (i=0; i<LAST_POPULATION_MONTHS; i++)
-        population[i] = 0;
+    int rank;
+    MPI_Comm_rank(simComm, &rank);
+    // The land actor owns the block of cells of its place in the land actors
+    for (landIndex=0; landIndex<LAND_ACTORS && cellWorkers[landIndex]!=rank; landIndex++);
+    cells = getLandCellCount(landIndex);
 
-    // Initialise infection
-    for (i=0; i<LAST_INFECTION_MONTHS; i++)
-        infection[i] = 0;
+    free(population);
+    free(infection);
+    free(populationSum);
+    free(infectionSum);
+    free(sendBuffer);
+    // Initialise population and infection of all the cells
+    population = (int *) calloc(cells * LAST_POPULATION_MONTHS, sizeof(int));
+    infection = (int *) calloc(cells * LAST_INFECTION_MONTHS, sizeof(int));
+    populationSum = (int *) calloc(cells, sizeof(int));
+    infectionSum = (int *) calloc(cells, sizeof(int));
+    sendBuffer = (int *) calloc(cells * 2, sizeof(int));
+    if (population == NULL || infection == NULL || populationSum == NULL || infectionSum == NULL || sendBuffer == NULL) {
+        fprintf(stderr, "[Land] Can not allocate the %d cells of the land\n", cells);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
+    startMonth = 0;
+    if (RESTART_FILE[0] != '\0')
+        restoreLand();
     return 0;
 }
 
 /**
- * @brief The actor work code.
+ * @brief The actor work code. The land keeps a ring of preposted persistent receives, blocks in
+ * MPI_Waitsome until some of them complete and handles the completed ones in the order they were
+ * posted, so the messages from one sender are handled in the order they were sent.
  *
  */
 int landWorker(){
-    int permissionSignal, probeFlag, receiveMonth, month;
+    int permissionSignal, receiveMonth, month, count, source, head, running, outcount, i;
+    int indices[LAND_RECV_SLOTS];
+    MPI_Status statusList[LAND_RECV_SLOTS];
+    double barrier;
 
     permissionSignal = 1;
-    month = 0;
+    month = startMonth;
     receiveMonth = 0;
+    running = 1;
+    head = 0;
+
+    if (LAND_RMA_MODE) {
+        // The squirrels and the controller update the cell in the window directly, the land only waits to stop
+        MPI_Recv(&receiveMonth, 1, MPI_INT, controllerWorkerPid, LAND_RECV_TAG, simComm, MPI_STATUS_IGNORE);
+        return 0;
+    }
+
+    startLandRequests();
+
+    while (running){
+        if (!recvDone[head]) {
+            // Wait for the requests from other workers
+            MPI_Waitsome(LAND_RECV_SLOTS, recvRequests, &outcount, indices, statusList);
+            for (i=0; i<outcount; i++) {
+                recvDone[indices[i]] = 1;
+                recvStatus[indices[i]] = statusList[i];
+            }
+            continue;
+        }
 
-    while (1){
-        // Recv the request from other workers
-        MPI_Iprobe(MPI_ANY_SOURCE, LAND_RECV_TAG, MPI_COMM_WORLD, &probeFlag, &status);
-        if (probeFlag) {
-            if (status.MPI_SOURCE == controllerWorkerPid) {
-                // This is the message from controller for update month
-                MPI_Recv(&receiveMonth, 1, MPI_INT, status.MPI_SOURCE, LAND_RECV_TAG, MPI_COMM_WORLD, &status);
-
-                if (receiveMonth == LAND_STOP_SIGNAL) {
-                    sendBuffer[0] = population[month % LAST_POPULATION_MONTHS];
-                    sendBuffer[1] = infection[month % LAST_INFECTION_MONTHS];
-                    MPI_Send(sendBuffer, 2, MPI_INT, status.MPI_SOURCE, CONTROLLER_RECV_TAG, MPI_COMM_WORLD);
-                    break;
-                } else if (receiveMonth == SQUIRREL_STOP_SIGNAL) {
-                    permissionSignal = 0;
-                    continue;
-                }
+        source = recvStatus[head].MPI_SOURCE;
+        if (source == controllerWorkerPid) {
+            // This is the message from controller for update month
+            receiveMonth = recvBuffers[head][0];
 
+            if (receiveMonth == LAND_STOP_SIGNAL) {
+                replyController(month);
+                running = 0;
+            } else if (receiveMonth == SQUIRREL_STOP_SIGNAL) {
+                permissionSignal = 0;
+            } else if (receiveMonth == CHECKPOINT_SIGNAL) {
+                writeCheckpoint(month, NULL, getLandFirstCell(landIndex), cells, population, infection, NULL);
+            } else {
                 month = receiveMonth;
 
-                sendBuffer[0] = population[(month - 1) % LAST_POPULATION_MONTHS];
-                sendBuffer[1] = infection[(month - 1) % LAST_INFECTION_MONTHS];
-                MPI_Send(sendBuffer, 2, MPI_INT, status.MPI_SOURCE, CONTROLLER_RECV_TAG, MPI_COMM_WORLD);
+                replyController(month - 1);
                 renewMonth(month);
+                barrier = traceBegin();
                 MPI_Barrier(landComm);
-            } else {
-                // This is the message from squirrels for update cell
-                if (permissionSignal)
-                    updateLand(month, status);
-                else
-                    terminateSquirrel(status);
+                traceEnd(TRACE_MONTH_BARRIER, barrier);
             }
+        } else {
+            // This is the message from squirrels for update cells, (cell, state) pairs of one or more visits
+            MPI_Get_count(&recvStatus[head], MPI_INT, &count);
+            if (permissionSignal)
+                updateLand(month, source, recvBuffers[head], count);
+            else
+                terminateSquirrel(source);
         }
+
+        // Post the slot again, it goes to the back of the ring
+        recvDone[head] = 0;
+        if (running)
+            MPI_Start(&recvRequests[head]);
+        head = (head + 1) % LAND_RECV_SLOTS;
     }
 
+    finishLandRequests();
     return 0;
 }
 
 /**
- * @brief The land actor recv the array recording all lands' pid.
+ * @brief Create and post the ring of persistent receives, and the persistent reply to the controller.
+ * The receives are started one by one rather than with MPI_Startall, which may start them in any order,
+ * because the messages must match the slots in ring order.
  *
  */
-void landInitialiseMessage(){
-    MPI_Recv(&controllerWorkerPid, 1, MPI_INT, 0, INITIAL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    MPI_Recv(cellWorkers, LENGTH_OF_LAND, MPI_INT, 0, INITIAL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    // Create a communicator for land actors group
-    MPI_Group_incl(worldGroup, LENGTH_OF_LAND, cellWorkers, &landGroup);
-    MPI_Comm_create(MPI_COMM_WORLD, landGroup, &landComm);
+void startLandRequests(){
+    int i;
+    for (i=0; i<LAND_RECV_SLOTS; i++) {
+        MPI_Recv_init(recvBuffers[i], LAND_BATCH_VISITS * 2, MPI_INT, MPI_ANY_SOURCE, LAND_RECV_TAG, simComm, &recvRequests[i]);
+        recvDone[i] = 0;
+    }
+    for (i=0; i<LAND_RECV_SLOTS; i++)
+        MPI_Start(&recvRequests[i]);
+
+    for (i=0; i<LAND_REPLY_SLOTS; i++)
+        replyRequests[i] = MPI_REQUEST_NULL;
+    replySlot = 0;
+
+    MPI_Send_init(sendBuffer, cells * 2, MPI_INT, controllerWorkerPid, CONTROLLER_RECV_TAG, simComm, &controllerReplyRequest);
 }
 
 /**
- * @brief The land recv the squirrels message and update its cell.
- * @param[in] month
- * The current month for land manipulate the population and infection level in its cell
- * @param[in] status
- * The MPI statue handle for getting the sender information
+ * @brief Cancel the receives still posted, wait for the replies in flight and free all the requests
  *
  */
-void updateLand(int month, MPI_Status status){
-    MPI_Recv(&squirlState, 1, MPI_INT, status.MPI_SOURCE, LAND_RECV_TAG, MPI_COMM_WORLD, &status);
+void finishLandRequests(){
+    int i;
+    for (i=0; i<LAND_RECV_SLOTS; i++) {
+        if (!recvDone[i]) {
+            MPI_Cancel(&recvRequests[i]);
+            MPI_Wait(&recvRequests[i], MPI_STATUS_IGNORE);
+        }
+        MPI_Request_free(&recvRequests[i]);
+    }
 
-    population[month % LAST_POPULATION_MONTHS]+=1;
-    if (squirlState == SICK)
-        infection[month % LAST_INFECTION_MONTHS]+=1;
+    MPI_Waitall(LAND_REPLY_SLOTS, replyRequests, MPI_STATUSES_IGNORE);
+    MPI_Wait(&controllerReplyRequest, MPI_STATUS_IGNORE);
+    MPI_Request_free(&controllerReplyRequest);
+}
 
-    sendBuffer[0]=0;
-    sendBuffer[1]=0;
+/**
+ * @brief Take the next buffer of the reply ring, waiting for the reply sent from it last time
+ * @return The reply buffer
+ *
+ */
+int * nextReplyBuffer(){
+    MPI_Wait(&replyRequests[replySlot], MPI_STATUS_IGNORE);
+    return replyBuffers[replySlot];
+}
+
+/**
+ * @brief Reply the population influx and the infection level of every cell in a month to the controller with
+ * the persistent send. The LAND_THREADS threads fill in the reply of a large block of cells, the main thread sends it.
+ * @param[in] month
+ * The month to report
+ *
+ */
+void replyController(int month){
     int i;
-    // According to the recv position, send the population and infection level back
-    for (i=0; i<LAST_POPULATION_MONTHS; i++)
-        sendBuffer[0]+=population[i];
+    MPI_Wait(&controllerReplyRequest, MPI_STATUS_IGNORE);
+    #pragma omp parallel for schedule(static) num_threads(LAND_THREADS) if(cells > LAND_THREAD_CHUNK)
+    for (i=0; i<cells; i++) {
+        sendBuffer[i*2] = population[i * LAST_POPULATION_MONTHS + RING_SLOT(month, LAST_POPULATION_MONTHS)];
+        sendBuffer[i*2+1] = infection[i * LAST_INFECTION_MONTHS + RING_SLOT(month, LAST_INFECTION_MONTHS)];
+    }
+    MPI_Start(&controllerReplyRequest);
+}
+
+/**
+ * @brief The land actor takes the controller's pid and the communicator of all the land actors, which is
+ * split at startup.
+ *
+ */
+void landInitialiseMessage(){
+    controllerWorkerPid = controllers[0];
+    landComm = actorComm;
+}
+
+/**
+ * @brief The land updates its cells once per visit of a squirrel's message, a squirrel actor sends one visit
+ * and a batched squirrel actor sends the visits of a tick. It replies to all the visits with one message,
+ * the population and infection level each squirrel gets are the same as if the visits came one by one in order.
+ * So the visits are added in order on one thread, unlike the month work of the cells.
+ * @param[in] month
+ * The current month for land manipulate the population and infection level in its cells
+ * @param[in] source
+ * The squirrel's pid
+ * @param[in] visits
+ * The (cell, state) pairs, the cell is the offset in the block of cells of this land
+ * @param[in] count
+ * The number of ints in visits
+ *
+ */
+void updateLand(int month, int source, int * visits, int count){
+    int i, cell;
+    int * reply = nextReplyBuffer();
 
-    for (i=0; i<LAST_INFECTION_MONTHS; i++)
-        sendBuffer[1]+=infection[i];
+    for (i=0; i<count/2; i++) {
+        cell = visits[i*2];
+        population[cell * LAST_POPULATION_MONTHS + RING_SLOT(month, LAST_POPULATION_MONTHS)]+=1;
+        populationSum[cell]++;
+        if (visits[i*2+1] == SICK) {
+            infection[cell * LAST_INFECTION_MONTHS + RING_SLOT(month, LAST_INFECTION_MONTHS)]+=1;
+            infectionSum[cell]++;
+        }
+        // Send the population and infection level of the last months back
+        reply[i*2] = populationSum[cell];
+        reply[i*2+1] = infectionSum[cell];
+    }
 
-    MPI_Send(sendBuffer, 2, MPI_INT, status.MPI_SOURCE, SQUIRREL_RECV_TAG, MPI_COMM_WORLD);
+    MPI_Isend(reply, count, MPI_INT, source, SQUIRREL_RECV_TAG, simComm, &replyRequests[replySlot]);
+    replySlot = (replySlot + 1) % LAND_REPLY_SLOTS;
 }
 
 /**
- * @brief The land recv the squirrels message but send terminate signal to squirrels.
- * @param[in] status
- * The MPI statue handle for getting the sender information
+ * @brief The land send terminate signal to the squirrel instead of updating its cell.
+ * @param[in] source
+ * The squirrel's pid
  *
  */
-void terminateSquirrel(MPI_Status status){
-    MPI_Recv(&squirlState, 1, MPI_INT, status.MPI_SOURCE, LAND_RECV_TAG, MPI_COMM_WORLD, &status);
-    MPI_Send(NULL, 0, MPI_INT, status.MPI_SOURCE, SQUIRREL_RECV_TAG, MPI_COMM_WORLD);
+void terminateSquirrel(int source){
+    nextReplyBuffer();
+    MPI_Isend(NULL, 0, MPI_INT, source, SQUIRREL_RECV_TAG, simComm, &replyRequests[replySlot]);
+    replySlot = (replySlot + 1) % LAND_REPLY_SLOTS;
 }
 
 /**
- * @brief The land clean the oldest popluation and infection level for a new month
+ * @brief The land clean the oldest popluation and infection level of its cells for a new month, with the
+ * LAND_THREADS threads for a large block of cells
  * @param[in] month
- * The current month for land manipulate the population and infection level in its cell
+ * The current month for land manipulate the population and infection level in its cells
  *
  */
 void renewMonth(int month){
-    population[month % LAST_POPULATION_MONTHS] = 0;
-    infection[month % LAST_INFECTION_MONTHS] = 0;
-}
\ No newline at end of file
+    int i, * oldPopulation, * oldInfection;
+    #pragma omp parallel for schedule(static) num_threads(LAND_THREADS) if(cells > LAND_THREAD_CHUNK) private(oldPopulation, oldInfection)
+    for (i=0; i<cells; i++) {
+        oldPopulation = &population[i * LAST_POPULATION_MONTHS + RING_SLOT(month, LAST_POPULATION_MONTHS)];
+        oldInfection = &infection[i * LAST_INFECTION_MONTHS + RING_SLOT(month, LAST_INFECTION_MONTHS)];
+        populationSum[i] -= *oldPopulation;
+        infectionSum[i] -= *oldInfection;
+        *oldPopulation = 0;
+        *oldInfection = 0;
+    }
+}
+
+/**
+ * @brief Take the cells of the land's block and the month from the checkpoint RESTART_FILE, whatever land
+ * actor wrote them, and work the running sums out again
+ *
+ */
+void restoreLand(){
+    int i, j;
+    int64_t header[CHECKPOINT_HEADER_FIELDS];
+
+    readCheckpointHeader(RESTART_FILE, header);
+    startMonth = (int) header[CHECKPOINT_MONTH];
+    readCheckpointCells(RESTART_FILE, getLandFirstCell(landIndex), cells, population, infection);
+
+    for (i=0; i<cells; i++) {
+        for (j=0; j<LAST_POPULATION_MONTHS; j++)
+            populationSum[i] += population[i * LAST_POPULATION_MONTHS + j];
+        for (j=0; j<LAST_INFECTION_MONTHS; j++)
+            infectionSum[i] += infection[i * LAST_INFECTION_MONTHS + j];
+    }
+}
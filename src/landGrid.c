@@ -0,0 +1,32 @@
+#include "../include/config.h"
+#include "../include/landGrid.h"
+
+/**
+ * Returns the land actor (0 to LAND_ACTORS - 1) that owns the cell. The land actor a owns the cells from
+ * getLandFirstCell(a) to getLandFirstCell(a + 1) - 1, so the blocks differ by one cell at most.
+ */
+int getLandOwner(int cell) {
+    return (int) (((long) LAND_ACTORS * (cell + 1) - 1) / LENGTH_OF_LAND);
+}
+
+/**
+ * Returns the first cell of the block of the land actor, the offset of a cell in the block of its owner is
+ * cell - getLandFirstCell(getLandOwner(cell)). getLandFirstCell(LAND_ACTORS) is the number of cells.
+ */
+int getLandFirstCell(int actor) {
+    return (int) ((long) actor * LENGTH_OF_LAND / LAND_ACTORS);
+}
+
+/**
+ * Returns the number of cells the land actor owns
+ */
+int getLandCellCount(int actor) {
+    return getLandFirstCell(actor + 1) - getLandFirstCell(actor);
+}
+
+/**
+ * Returns the largest number of cells a land actor owns
+ */
+int getLandMaxCellCount() {
+    return (LENGTH_OF_LAND + LAND_ACTORS - 1) / LAND_ACTORS;
+}
@@ -0,0 +1,220 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "../include/landWindow.h"
+#include "../include/landGrid.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+#include "../include/actorConfig.h"
+
+/** The records of the land cells this process hosts if it becomes a land actor, and the window exposing them **/
+static int * landRecord;
+static MPI_Win landWindow;
+/** The buffer of the operations on the window, it grows to the largest one **/
+static int * scratch;
+static int scratchSize;
+
+static int * reserveScratch(int size);
+static void readLandRecords(int landPid, int cells, int * records);
+static int shiftLandMonths(int * record, int current, int old, int months);
+
+/**
+ * @brief Create the window of the land cells. It is collective over simComm so every process of the simulation calls it
+ * before the process pool starts, every process exposes the records of as many cells as a land actor can own
+ * and the land actors' ones are used. The record of the cell with offset i in the block of its land actor is
+ * at i * LAND_RECORD_SIZE. The window memory is allocated by MPI so that the processes on one node can share
+ * it directly.
+ *
+ */
+void createLandWindow(){
+    int i, rank, size;
+    MPI_Comm_rank(simComm, &rank);
+    size = getLandMaxCellCount() * LAND_RECORD_SIZE;
+    MPI_Win_allocate(sizeof(int) * size, sizeof(int), MPI_INFO_NULL, simComm, &landRecord, &landWindow);
+
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, landWindow);
+    for (i=0; i<size; i++)
+        landRecord[i] = 0;
+    MPI_Win_unlock(rank, landWindow);
+    // Nobody visits a cell before it is clean
+    MPI_Barrier(simComm);
+}
+
+/**
+ * @brief Free the window of the land cells, every process calls it after the process pool is finalised
+ *
+ */
+void freeLandWindow(){
+    MPI_Win_free(&landWindow);
+    free(scratch);
+    scratch = NULL;
+    scratchSize = 0;
+}
+
+/**
+ * @brief Squirrels visit cells of one land actor with one atomic update of the head of each cell's record,
+ * all under one lock. The visits are added to the current month and the running sums, and the head before
+ * the visits is read back in the same operation.
+ * @param[in] landPid
+ * The pid of the land actor hosting the cells
+ * @param[in] count
+ * The number of cells visited
+ * @param[in] cells
+ * The offsets of the cells in the block of the land actor
+ * @param[in] visits
+ * The number of visits of each cell
+ * @param[in] sickVisits
+ * The number of the visits made by sick squirrels to each cell
+ * @param[out] popNInf
+ * The population influx and infection level of each cell before the visits, one pair per cell
+ * @return 1 if the squirrels can proceed, 0 if they should stop
+ *
+ */
+int visitLandWindow(int landPid, int count, const int * cells, const int * visits, const int * sickVisits, int * popNInf){
+    int i, proceed, * increment, * record;
+
+    increment = reserveScratch(count * LAND_RECORD_VISIT_SIZE * 2);
+    record = &increment[count * LAND_RECORD_VISIT_SIZE];
+
+    for (i=0; i<count; i++) {
+        increment[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_POPULATION_SUM] = visits[i];
+        increment[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_INFECTION_SUM] = sickVisits[i];
+        increment[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_POPULATION] = visits[i];
+        increment[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_INFECTION] = sickVisits[i];
+        increment[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_STOP] = 0;
+    }
+
+    MPI_Win_lock(MPI_LOCK_SHARED, landPid, 0, landWindow);
+    for (i=0; i<count; i++)
+        MPI_Get_accumulate(&increment[i * LAND_RECORD_VISIT_SIZE], LAND_RECORD_VISIT_SIZE, MPI_INT,
+                           &record[i * LAND_RECORD_VISIT_SIZE], LAND_RECORD_VISIT_SIZE, MPI_INT,
+                           landPid, (MPI_Aint) cells[i] * LAND_RECORD_SIZE, LAND_RECORD_VISIT_SIZE, MPI_INT, MPI_SUM, landWindow);
+    MPI_Win_unlock(landPid, landWindow);
+
+    proceed = 1;
+    for (i=0; i<count; i++) {
+        popNInf[i*2] = record[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_POPULATION_SUM];
+        popNInf[i*2+1] = record[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_INFECTION_SUM];
+        if (record[i * LAND_RECORD_VISIT_SIZE + LAND_RECORD_STOP])
+            proceed = 0;
+    }
+    return proceed;
+}
+
+/**
+ * @brief The controller moves the cells of a land actor to a new month. The month that just finished is
+ * reported, and the rings move on by one month so the oldest one is dropped and the current one is clean,
+ * as renewMonth in landActor.c does.
+ * @param[in] landPid
+ * The pid of the land actor hosting the cells
+ * @param[in] cells
+ * The number of cells of the land actor
+ * @param[out] popNInf
+ * The population influx and infection level of the month that just finished, one pair per cell
+ *
+ */
+void renewLandWindow(int landPid, int cells, int * popNInf){
+    int i, * record, * records = reserveScratch(cells * LAND_RECORD_SIZE);
+
+    // The exclusive lock keeps the squirrels' visits out while the rings move
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, landPid, 0, landWindow);
+    readLandRecords(landPid, cells, records);
+
+    for (i=0; i<cells; i++) {
+        record = &records[i * LAND_RECORD_SIZE];
+        popNInf[i*2] = record[LAND_RECORD_POPULATION];
+        popNInf[i*2+1] = record[LAND_RECORD_INFECTION];
+
+        record[LAND_RECORD_POPULATION_SUM] -= shiftLandMonths(record, LAND_RECORD_POPULATION, LAND_RECORD_OLD_POPULATION, LAST_POPULATION_MONTHS);
+        record[LAND_RECORD_INFECTION_SUM] -= shiftLandMonths(record, LAND_RECORD_INFECTION, LAND_RECORD_OLD_INFECTION, LAST_INFECTION_MONTHS);
+    }
+
+    MPI_Put(records, cells * LAND_RECORD_SIZE, MPI_INT, landPid, 0, cells * LAND_RECORD_SIZE, MPI_INT, landWindow);
+    MPI_Win_unlock(landPid, landWindow);
+}
+
+/**
+ * @brief The controller sets the stop flag of the cells of a land actor, the squirrels visiting them afterwards stop
+ * @param[in] landPid
+ * The pid of the land actor hosting the cells
+ * @param[in] cells
+ * The number of cells of the land actor
+ * @param[out] popNInf
+ * The population influx and infection level of the current month when the cells stop, one pair per cell
+ *
+ */
+void stopLandWindow(int landPid, int cells, int * popNInf){
+    int i, * records = reserveScratch(cells * LAND_RECORD_SIZE);
+
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, landPid, 0, landWindow);
+    readLandRecords(landPid, cells, records);
+
+    for (i=0; i<cells; i++) {
+        popNInf[i*2] = records[i * LAND_RECORD_SIZE + LAND_RECORD_POPULATION];
+        popNInf[i*2+1] = records[i * LAND_RECORD_SIZE + LAND_RECORD_INFECTION];
+        records[i * LAND_RECORD_SIZE + LAND_RECORD_STOP] = 1;
+    }
+
+    MPI_Put(records, cells * LAND_RECORD_SIZE, MPI_INT, landPid, 0, cells * LAND_RECORD_SIZE, MPI_INT, landWindow);
+    MPI_Win_unlock(landPid, landWindow);
+}
+
+/**
+ * @brief Move the months of one ring of a record on by one month, the current month goes first in the older
+ * months and starts clean
+ * @param[in,out] record
+ * The record of the land cell
+ * @param[in] current
+ * The position of the current month in the record
+ * @param[in] old
+ * The position of the older months in the record
+ * @param[in] months
+ * The number of months in the ring
+ * @return The value of the month dropped from the ring
+ *
+ */
+static int shiftLandMonths(int * record, int current, int old, int months){
+    int i, dropped;
+
+    dropped = months > 1 ? record[old + months - 2] : record[current];
+    for (i=months-2; i>0; i--)
+        record[old + i] = record[old + i - 1];
+    if (months > 1)
+        record[old] = record[current];
+    record[current] = 0;
+    return dropped;
+}
+
+/**
+ * @brief Read the records of the cells of a land actor, the caller holds the exclusive lock of the land
+ *
+ */
+static void readLandRecords(int landPid, int cells, int * records){
+    MPI_Get(records, cells * LAND_RECORD_SIZE, MPI_INT, landPid, 0, cells * LAND_RECORD_SIZE, MPI_INT, landWindow);
+    MPI_Win_flush(landPid, landWindow);
+}
+
+/**
+ * @brief Grow the buffer of the operations on the window
+ * @param[in] size
+ * The number of ints needed
+ * @return The buffer
+ *
+ */
+static int * reserveScratch(int size){
+    if (size <= scratchSize)
+        return scratch;
+
+    free(scratch);
+    scratch = (int *) malloc(sizeof(int) * size);
+    if (scratch == NULL) {
+        fprintf(stderr, "[LandWindow] Can not allocate a buffer of %d ints\n", size);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    scratchSize = size;
+    return scratch;
+}
@@ -0,0 +1,159 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#include "../include/latency.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+
+#define LATENCY_ENTRY(month, kind, bucket) ((((month) - 1) * LATENCY_KINDS + (kind)) * LATENCY_BUCKETS + (bucket))
+
+static const char * latencyKindNames[LATENCY_KINDS] = {"squirlGo", "reproduce", "startWorkerProcess"};
+
+/** The counts of every month, kind and bucket of this process, the months are 1 to MONTH_LIMIT **/
+static int * latencyCounts;
+static int latencyEnabled;
+
+static int latencyBucket(long nanoseconds);
+static double latencyPercentile(const int * counts, long total, double fraction);
+
+/**
+ * @brief Start counting the latencies, nothing is counted before it or if enabled is 0
+ * @param[in] enabled
+ *
+ */
+void startLatencyHistograms(int enabled){
+    latencyEnabled = enabled;
+    if (!enabled)
+        return;
+
+    latencyCounts = (int *) calloc((size_t) MONTH_LIMIT * LATENCY_KINDS * LATENCY_BUCKETS, sizeof(int));
+    if (latencyCounts == NULL) {
+        fprintf(stderr, "[Latency] Can not allocate the histograms of %d months\n", MONTH_LIMIT);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+/**
+ * @brief The time a wait begins at, if the latencies are counted
+ * @return The time, or 0
+ *
+ */
+double latencyBegin(){
+    return latencyEnabled ? MPI_Wtime() : 0;
+}
+
+/**
+ * @brief Count a wait that began at begin and ends now
+ * @param[in] kind
+ * @param[in] month
+ * The month of the squirrel, the months after MONTH_LIMIT count in the last month
+ * @param[in] begin
+ * The time latencyBegin returned
+ *
+ */
+void recordLatency(int kind, int month, double begin){
+    if (!latencyEnabled)
+        return;
+
+    if (month < 1)
+        month = 1;
+    if (month > MONTH_LIMIT)
+        month = MONTH_LIMIT;
+    latencyCounts[LATENCY_ENTRY(month, kind, latencyBucket((long) ((MPI_Wtime() - begin) * 1e9)))]++;
+}
+
+/**
+ * @brief Add up the histograms of all the processes of the simulation, and print the 50th, 99th and 99.9th
+ * percentiles of every month and kind on the master, in microseconds. It is collective over simComm, every process
+ * calls it when the pool is finalised.
+ *
+ */
+void printLatencyHistograms(){
+    int rank, month, kind, bucket, * counts = NULL, * histogram;
+    long entries = (long) MONTH_LIMIT * LATENCY_KINDS * LATENCY_BUCKETS, total;
+
+    MPI_Comm_rank(simComm, &rank);
+    if (rank == 0) {
+        counts = (int *) malloc(sizeof(int) * entries);
+        if (counts == NULL) {
+            fprintf(stderr, "[Latency] Can not allocate the histograms of %d months\n", MONTH_LIMIT);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Reduce(latencyCounts, counts, (int) entries, MPI_INT, MPI_SUM, 0, simComm);
+
+    if (rank == 0) {
+        if (ENSEMBLE_REPLICAS > 1)
+            printf("Latency of replica %d, us\n", ensembleReplica);
+        else
+            printf("Latency, us\n");
+        printf("%5s  %-18s %10s %10s %10s %10s\n", "month", "wait", "count", "p50", "p99", "p99.9");
+        for (month=1; month<=MONTH_LIMIT; month++) {
+            for (kind=0; kind<LATENCY_KINDS; kind++) {
+                histogram = &counts[LATENCY_ENTRY(month, kind, 0)];
+                total = 0;
+                for (bucket=0; bucket<LATENCY_BUCKETS; bucket++)
+                    total += histogram[bucket];
+                if (total == 0)
+                    continue;
+                printf("%5d  %-18s %10ld %10.2f %10.2f %10.2f\n", month, latencyKindNames[kind], total,
+                       latencyPercentile(histogram, total, 0.5) / 1e3, latencyPercentile(histogram, total, 0.99) / 1e3,
+                       latencyPercentile(histogram, total, 0.999) / 1e3);
+            }
+        }
+    }
+
+    free(counts);
+    free(latencyCounts);
+    latencyCounts = NULL;
+}
+
+/**
+ * @brief The bucket of a latency. The latencies below 2 * LATENCY_SUB_BUCKETS ns have a bucket each, the others are
+ * shifted right until they are below it, and the bucket is the shift and the bits left.
+ * @param[in] nanoseconds
+ * @return The bucket
+ *
+ */
+static int latencyBucket(long nanoseconds){
+    int shift = 0;
+    if (nanoseconds < 0)
+        nanoseconds = 0;
+
+    while ((nanoseconds >> shift) >= 2 * LATENCY_SUB_BUCKETS && shift < LATENCY_MAX_SHIFT)
+        shift++;
+    if ((nanoseconds >> shift) >= 2 * LATENCY_SUB_BUCKETS)
+        return LATENCY_BUCKETS - 1;
+    return LATENCY_SUB_BUCKETS * shift + (int) (nanoseconds >> shift);
+}
+
+/**
+ * @brief The latency below which a fraction of the counts of a histogram are
+ * @param[in] counts
+ * @param[in] total
+ * The counts of the histogram added up
+ * @param[in] fraction
+ * @return The middle of the bucket of the percentile, in ns
+ *
+ */
+static double latencyPercentile(const int * counts, long total, double fraction){
+    int bucket, shift;
+    long rank = (long) ceil(fraction * total), seen = 0;
+
+    for (bucket=0; bucket<LATENCY_BUCKETS - 1; bucket++) {
+        seen += counts[bucket];
+        if (seen >= rank)
+            break;
+    }
+
+    // The bucket is shift * LATENCY_SUB_BUCKETS + the bits left, the first two rows are not shifted
+    shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    if (shift < 0)
+        shift = 0;
+    return (double) ((long) (bucket - LATENCY_SUB_BUCKETS * shift) << shift) + ((1L << shift) - 1) / 2.0;
+}
@@ -6,13 +6,14 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <math.h>
 #include <mpi.h>
 #include "../include/pool.h"
 #include "../include/main.h"
 #include "../include/squirrel-functions.h"
 
-static long seed;
+static struct SquirrelRNG seed;
 int cellWorkers[LENGTH_OF_LAND];
 int controllerWorkerPid;
 MPI_Group worldGroup, landGroup;
@@ -38,8 +39,8 @@ int main(int argc, char* argv[]) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    seed = -1-rank;
-    initialiseRNG(&seed);
+    seedSquirrelRNG(&seed, 2020, (uint64_t) rank);
+    seekSquirrelRNG(&seed, 0, SQUIRREL_RNG_PLACE);
 
     MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
 
@@ -414,6 +415,7 @@ struct Squirrel squirlGo(int rank, struct Squirrel squirl) {
     MPI_Status status;
 
     float x_new, y_new;
+    seekSquirrelRNG(&seed, squirl.steps, SQUIRREL_RNG_MOVE);
     squirrelStep(squirl.x, squirl.y, &x_new, &y_new, &seed);
     squirl.x = x_new;
     squirl.y = y_new;
@@ -432,6 +434,8 @@ struct Squirrel squirlGo(int rank, struct Squirrel squirl) {
         MPI_Recv(recvBuffer, 2, MPI_INT, cellWorkers[position], 6, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
     }
 
+    seekSquirrelRNG(&seed, squirl.steps, SQUIRREL_RNG_LIFE);
+
     // Update population and infection level
     squirl.pop[squirl.steps % LAST_POPULATION_STEPS] = recvBuffer[0];
     squirl.inf[squirl.steps % LAST_INFECTION_STEPS] = recvBuffer[1];
@@ -0,0 +1,22 @@
+#include <stdio.h>
+
+#include "../include/monthLog.h"
+
+/**
+ * Prints the report of a month: the squirrel counts, then the population influx and the infection level of
+ * every land cell. popNInf holds the (population, infection) pair of each of the cells, one after another.
+ * This is the output format of the simulation whichever engine runs it.
+ */
+void printMonthLog(int month, int alive, int infected, int dead, int * popNInf, int cells) {
+    int i;
+    printf("Month %2d\talive %d\tinfected %d\tdead %d\n", month, alive, infected, dead);
+    printf("POPULATION INFLUX\t[\t");
+    for (i=0; i<cells; i++)
+        printf("%d\t", popNInf[i*2]);
+    printf("]\n");
+
+    printf("INFECTION  LEVEL \t[\t");
+    for (i=0; i<cells; i++)
+        printf("%d\t", popNInf[i*2+1]);
+    printf("]\n\n");
+}
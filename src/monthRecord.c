@@ -0,0 +1,100 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "../include/monthRecord.h"
+#include "../include/config.h"
+
+/** The file, and the ring of month records in flight to it **/
+static MPI_File monthFile;
+static int * slotBuffers;
+static MPI_Request slotRequests[MONTH_RECORD_SLOTS];
+static int header[MONTH_RECORD_HEADER_SIZE / sizeof(int)];
+static int slot;
+static int recordInts;
+static int recordCells;
+static MPI_Offset recordOffset;
+
+/**
+ * @brief Open the binary month output of this process and start writing its header. The writes do not block,
+ * a month waits only when MONTH_RECORD_SLOTS months are still in flight.
+ * @param[in] path
+ * @param[in] cells
+ * The number of land cells
+ * @param[in] withCells
+ * 1 to write the population and infection of every cell each month, 0 for the counts only
+ *
+ */
+void openMonthRecords(const char * path, int cells, int withCells){
+    int i;
+
+    if (MPI_File_open(MPI_COMM_SELF, path, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &monthFile) != MPI_SUCCESS) {
+        fprintf(stderr, "[MonthRecord] Can not open the month output %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(monthFile, 0);
+
+    recordCells = withCells ? cells : 0;
+    recordInts = MONTH_RECORD_COUNTS + recordCells * 2;
+    slotBuffers = (int *) malloc(sizeof(int) * recordInts * MONTH_RECORD_SLOTS);
+    if (slotBuffers == NULL) {
+        fprintf(stderr, "[MonthRecord] Can not allocate the month records of %d cells\n", recordCells);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (i=0; i<MONTH_RECORD_SLOTS; i++)
+        slotRequests[i] = MPI_REQUEST_NULL;
+    slot = 0;
+
+    memcpy(header, MONTH_RECORD_MAGIC, MONTH_RECORD_MAGIC_SIZE);
+    header[MONTH_RECORD_MAGIC_SIZE / sizeof(int) + MONTH_RECORD_HEADER_CELLS] = cells;
+    header[MONTH_RECORD_MAGIC_SIZE / sizeof(int) + MONTH_RECORD_HEADER_WITH_CELLS] = withCells;
+    // The header takes the last slot, the first months do not need it
+    MPI_File_iwrite_at(monthFile, 0, header, MONTH_RECORD_HEADER_SIZE, MPI_BYTE, &slotRequests[MONTH_RECORD_SLOTS - 1]);
+    recordOffset = MONTH_RECORD_HEADER_SIZE;
+}
+
+/**
+ * @brief Write the record of a month without waiting for it. The record is copied, so popNInf can change
+ * as soon as this returns.
+ * @param[in] month
+ * @param[in] alive
+ * @param[in] infected
+ * @param[in] dead
+ * @param[in] last
+ * 1 if the simulation stopped before MONTH_LIMIT and this is its last output
+ * @param[in] popNInf
+ * The (population, infection) pair of every cell
+ *
+ */
+void writeMonthRecord(int month, int alive, int infected, int dead, int last, int * popNInf){
+    int * record = &slotBuffers[slot * recordInts];
+
+    // The slot is free again once its previous month has been written
+    MPI_Wait(&slotRequests[slot], MPI_STATUS_IGNORE);
+
+    record[MONTH_RECORD_MONTH] = month;
+    record[MONTH_RECORD_ALIVE] = alive;
+    record[MONTH_RECORD_INFECTED] = infected;
+    record[MONTH_RECORD_DEAD] = dead;
+    record[MONTH_RECORD_LAST] = last;
+    memcpy(&record[MONTH_RECORD_COUNTS], popNInf, sizeof(int) * recordCells * 2);
+
+    MPI_File_iwrite_at(monthFile, recordOffset, record, recordInts, MPI_INT, &slotRequests[slot]);
+    recordOffset += (MPI_Offset) sizeof(int) * recordInts;
+    slot = (slot + 1) % MONTH_RECORD_SLOTS;
+}
+
+/**
+ * @brief Wait for the months in flight and close the binary month output
+ *
+ */
+void closeMonthRecords(){
+    MPI_Waitall(MONTH_RECORD_SLOTS, slotRequests, MPI_STATUSES_IGNORE);
+    MPI_File_close(&monthFile);
+    free(slotBuffers);
+    slotBuffers = NULL;
+}
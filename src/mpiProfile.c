@@ -0,0 +1,722 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <mpi.h>
+#include "../include/mpiProfile.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+#include "../include/actorConfig.h"
+
+/** The calls that are profiled **/
+#define PROFILE_SEND 0
+#define PROFILE_ISEND 1
+#define PROFILE_RECV 2
+#define PROFILE_IRECV 3
+#define PROFILE_PROBE 4
+#define PROFILE_IPROBE 5
+#define PROFILE_START 6
+#define PROFILE_WAIT 7
+#define PROFILE_WAITALL 8
+#define PROFILE_WAITSOME 9
+#define PROFILE_TEST 10
+#define PROFILE_TESTALL 11
+#define PROFILE_BCAST 12
+#define PROFILE_BARRIER 13
+#define PROFILE_SEND_INIT 14
+#define PROFILE_RECV_INIT 15
+#define PROFILE_REQUEST_FREE 16
+#define PROFILE_REDUCE 17
+#define PROFILE_IREDUCE 18
+#define PROFILE_ALLREDUCE 19
+#define PROFILE_GATHER 20
+#define PROFILE_ALLGATHER 21
+#define PROFILE_EXSCAN 22
+#define PROFILE_WIN_LOCK 23
+#define PROFILE_WIN_UNLOCK 24
+#define PROFILE_WIN_FLUSH 25
+#define PROFILE_PUT 26
+#define PROFILE_GET 27
+#define PROFILE_GET_ACCUMULATE 28
+#define PROFILE_CALLS 29
+
+/** The tags of actorConfig.h from INITIAL_TAG on, then the other tags and the calls without a tag **/
+#define PROFILE_FIRST_TAG INITIAL_TAG
+#define PROFILE_OTHER_TAG (LEASE_TAG - INITIAL_TAG + 1)
+#define PROFILE_NO_TAG (PROFILE_OTHER_TAG + 1)
+#define PROFILE_TAGS (PROFILE_NO_TAG + 1)
+
+#define PROFILE_ENTRIES (PROFILE_ROLES * PROFILE_CALLS * PROFILE_TAGS)
+#define PROFILE_ENTRY(role, call, tag) (((role) * PROFILE_CALLS + (call)) * PROFILE_TAGS + (tag))
+
+static const char * profileRoleNames[PROFILE_ROLES] = {"controller", "land", "squirrel", "batch", "pool"};
+static const char * profileCallNames[PROFILE_CALLS] = {"MPI_Send", "MPI_Isend", "MPI_Recv", "MPI_Irecv", "MPI_Probe",
+    "MPI_Iprobe", "MPI_Start", "MPI_Wait", "MPI_Waitall", "MPI_Waitsome", "MPI_Test", "MPI_Testall", "MPI_Bcast",
+    "MPI_Barrier", "MPI_Send_init", "MPI_Recv_init", "MPI_Request_free", "MPI_Reduce", "MPI_Ireduce", "MPI_Allreduce",
+    "MPI_Gather", "MPI_Allgather", "MPI_Exscan", "MPI_Win_lock", "MPI_Win_unlock", "MPI_Win_flush", "MPI_Put", "MPI_Get",
+    "MPI_Get_accumulate"};
+static const char * profileTagNames[PROFILE_TAGS] = {"INITIAL_TAG", "SQUIRREL_RECV_TAG", "SQUIRREL_CONTROLLER_TAG",
+    "LAND_RECV_TAG", "CONTROLLER_RECV_TAG", "EPOCH_TAG", "ACCOUNT_TAG", "LEASE_TAG", "other", "-"};
+
+/** The calls, the bytes and the seconds of every role, call and tag of this process **/
+static long profileCalls[PROFILE_ENTRIES];
+static long profileBytes[PROFILE_ENTRIES];
+static double profileSeconds[PROFILE_ENTRIES];
+static int profileRanRole[PROFILE_ROLES];  // 1 for the roles this process had
+static int profileEnabled;
+static int profileRole = PROFILE_POOL;
+
+/**
+ * The requests in flight, so the waits and the tests are counted by the tags of the requests they complete. A request
+ * is known by the address the caller keeps it at, which the simulation passes to the create and the completion calls
+ * alike. The bytes of a send are counted when it starts, the bytes of a receive when it completes.
+ */
+struct ProfileRequest {
+    MPI_Request * request;  // NULL for a free slot of the table
+    MPI_Datatype datatype;
+    long bytes;
+    int tag;
+    int receive;
+    int active;  // 0 for a persistent request that is not started
+};
+static struct ProfileRequest * requestTable;  // Open addressing with linear probing, at most half full
+static int requestCapacity;
+static int requestCount;
+static MPI_Status * profileStatuses;  // The statuses of the completion calls the caller ignores
+static int profileStatusCount;
+
+static double profileStart();
+static void recordCall(int call, int tag, long bytes, double start);
+static void addCall(int call, int tag, long bytes, double seconds);
+static long messageBytes(int count, MPI_Datatype datatype);
+static int requestHome(MPI_Request * request);
+static int requestSlot(MPI_Request * request);
+static void trackRequest(MPI_Request * request, int tag, int receive, long bytes, MPI_Datatype datatype, int active);
+static void forgetRequest(MPI_Request * request);
+static void completeRequests(int call, MPI_Request requests[], int indices[], MPI_Status * statuses, int count,
+                             double start);
+static MPI_Status * statusesFor(MPI_Status * statuses, int count);
+
+/**
+ * @brief Start profiling the calls, nothing is recorded before it or if enabled is 0
+ * @param[in] enabled
+ *
+ */
+void startMpiProfile(int enabled){
+    profileEnabled = enabled;
+    profileRanRole[profileRole] = 1;
+}
+
+/**
+ * @brief The calls from now on are the ones of role
+ * @param[in] role
+ * An actor identity, or PROFILE_POOL
+ *
+ */
+void setMpiProfileRole(int role){
+    profileRole = role >= 0 && role < PROFILE_ROLES ? role : PROFILE_POOL;
+    profileRanRole[profileRole] = 1;
+}
+
+/**
+ * @brief The point-to-point messages this process sent while it was profiled
+ * @return The calls of MPI_Send and MPI_Isend
+ *
+ */
+long getMpiProfileMessages(){
+    int role, tag;
+    long messages = 0;
+    for (role=0; role<PROFILE_ROLES; role++) {
+        for (tag=0; tag<PROFILE_TAGS; tag++) {
+            messages += profileCalls[PROFILE_ENTRY(role, PROFILE_SEND, tag)];
+            messages += profileCalls[PROFILE_ENTRY(role, PROFILE_ISEND, tag)];
+        }
+    }
+    return messages;
+}
+
+/**
+ * @brief Add up the profiles of all the processes of the simulation by role, and print them on the master. It is
+ * collective over simComm, every process calls it when the pool is finalised.
+ *
+ */
+void printMpiProfile(){
+    int i, role, call, tag, rank, ranks[PROFILE_ROLES];
+    long * calls, * bytes;
+    double * seconds;
+
+    MPI_Comm_rank(simComm, &rank);
+    calls = (long *) malloc(sizeof(long) * PROFILE_ENTRIES);
+    bytes = (long *) malloc(sizeof(long) * PROFILE_ENTRIES);
+    seconds = (double *) malloc(sizeof(double) * PROFILE_ENTRIES);
+    if (calls == NULL || bytes == NULL || seconds == NULL) {
+        fprintf(stderr, "[Profile] Can not allocate the profile\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // The reductions of the profile are not profiled, so they do not change it while it is summed
+    PMPI_Reduce(profileCalls, calls, PROFILE_ENTRIES, MPI_LONG, MPI_SUM, 0, simComm);
+    PMPI_Reduce(profileBytes, bytes, PROFILE_ENTRIES, MPI_LONG, MPI_SUM, 0, simComm);
+    PMPI_Reduce(profileSeconds, seconds, PROFILE_ENTRIES, MPI_DOUBLE, MPI_SUM, 0, simComm);
+    PMPI_Reduce(profileRanRole, ranks, PROFILE_ROLES, MPI_INT, MPI_SUM, 0, simComm);
+
+    if (rank == 0) {
+        if (ENSEMBLE_REPLICAS > 1)
+            printf("MPI profile of replica %d\n", ensembleReplica);
+        else
+            printf("MPI profile\n");
+        printf("%-10s %6s  %-18s %-24s %12s %14s %12s\n", "role", "ranks", "call", "tag", "calls", "bytes", "seconds");
+        for (role=0; role<PROFILE_ROLES; role++) {
+            for (call=0; call<PROFILE_CALLS; call++) {
+                for (tag=0; tag<PROFILE_TAGS; tag++) {
+                    i = PROFILE_ENTRY(role, call, tag);
+                    if (calls[i] == 0)
+                        continue;
+                    printf("%-10s %6d  %-18s %-24s %12ld %14ld %12.6f\n", profileRoleNames[role], ranks[role],
+                           profileCallNames[call], profileTagNames[tag], calls[i], bytes[i], seconds[i]);
+                }
+            }
+        }
+    }
+
+    free(calls);
+    free(bytes);
+    free(seconds);
+    free(requestTable);
+    free(profileStatuses);
+    requestTable = NULL;
+    profileStatuses = NULL;
+    requestCapacity = requestCount = profileStatusCount = 0;
+}
+
+/**
+ * @brief The time a call starts at, if the calls are profiled
+ * @return The time, or 0
+ *
+ */
+static double profileStart(){
+    return profileEnabled ? MPI_Wtime() : 0;
+}
+
+/**
+ * @brief Add a call that started at start to the profile of the role of the process
+ * @param[in] call
+ * @param[in] tag
+ * The tag of the message, or MPI_ANY_TAG if the call has none
+ * @param[in] bytes
+ * @param[in] start
+ *
+ */
+static void recordCall(int call, int tag, long bytes, double start){
+    if (profileEnabled)
+        addCall(call, tag, bytes, MPI_Wtime() - start);
+}
+
+/**
+ * @brief Add a call of some seconds to the profile of the role of the process
+ * @param[in] call
+ * @param[in] tag
+ * The tag of the message, or MPI_ANY_TAG if the call has none
+ * @param[in] bytes
+ * @param[in] seconds
+ *
+ */
+static void addCall(int call, int tag, long bytes, double seconds){
+    int i;
+
+    if (tag == MPI_ANY_TAG)
+        tag = PROFILE_NO_TAG;
+    else if (tag >= PROFILE_FIRST_TAG && tag < PROFILE_FIRST_TAG + PROFILE_OTHER_TAG)
+        tag -= PROFILE_FIRST_TAG;
+    else
+        tag = PROFILE_OTHER_TAG;
+
+    i = PROFILE_ENTRY(profileRole, call, tag);
+    profileCalls[i]++;
+    profileBytes[i] += bytes;
+    profileSeconds[i] += seconds;
+}
+
+/**
+ * @brief The bytes of count elements of a datatype, if the calls are profiled
+ * @param[in] count
+ * @param[in] datatype
+ * @return The bytes, or 0
+ *
+ */
+static long messageBytes(int count, MPI_Datatype datatype){
+    int size;
+    if (!profileEnabled || count <= 0)
+        return 0;
+    PMPI_Type_size(datatype, &size);
+    return (long) count * size;
+}
+
+/**
+ * @brief The slot of the table a request is looked for from
+ * @param[in] request
+ * @return The slot
+ *
+ */
+static int requestHome(MPI_Request * request){
+    return (int) ((((uintptr_t) request) >> 3) * 2654435761u & (uintptr_t) (requestCapacity - 1));
+}
+
+/**
+ * @brief The slot of a request in the table
+ * @param[in] request
+ * @return The slot, or -1 if the request is not in flight
+ *
+ */
+static int requestSlot(MPI_Request * request){
+    int slot;
+    if (requestCapacity == 0)
+        return -1;
+
+    slot = requestHome(request);
+    while (requestTable[slot].request != NULL) {
+        if (requestTable[slot].request == request)
+            return slot;
+        slot = (slot + 1) & (requestCapacity - 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief Keep the tag and the bytes of a request a call created, over the request the caller kept at the same address
+ * @param[in] request
+ * @param[in] tag
+ * @param[in] receive
+ * 1 if the bytes come when the request completes
+ * @param[in] bytes
+ * @param[in] datatype
+ * @param[in] active
+ *
+ */
+static void trackRequest(MPI_Request * request, int tag, int receive, long bytes, MPI_Datatype datatype, int active){
+    int i, slot, capacity = requestCapacity;
+    struct ProfileRequest * table = requestTable;
+
+    slot = requestSlot(request);
+    if (slot < 0) {
+        if ((requestCount + 1) * 2 > requestCapacity) {
+            // Grow the table and put the requests in flight back in it
+            requestCapacity = capacity ? capacity * 2 : 256;
+            requestTable = (struct ProfileRequest *) calloc(requestCapacity, sizeof(struct ProfileRequest));
+            if (requestTable == NULL) {
+                fprintf(stderr, "[Profile] Can not allocate the table of %d requests\n", requestCapacity);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            requestCount = 0;
+            for (i=0; i<capacity; i++) {
+                if (table[i].request != NULL)
+                    trackRequest(table[i].request, table[i].tag, table[i].receive, table[i].bytes, table[i].datatype,
+                                 table[i].active);
+            }
+            free(table);
+        }
+
+        slot = requestHome(request);
+        while (requestTable[slot].request != NULL)
+            slot = (slot + 1) & (requestCapacity - 1);
+        requestCount++;
+    }
+
+    requestTable[slot].request = request;
+    requestTable[slot].datatype = datatype;
+    requestTable[slot].bytes = bytes;
+    requestTable[slot].tag = tag;
+    requestTable[slot].receive = receive;
+    requestTable[slot].active = active;
+}
+
+/**
+ * @brief Take a request out of the table, and move the requests after it back so the probes still find them
+ * @param[in] request
+ *
+ */
+static void forgetRequest(MPI_Request * request){
+    int slot = requestSlot(request), next, home;
+    if (slot < 0)
+        return;
+
+    requestTable[slot].request = NULL;
+    requestCount--;
+    for (next=(slot + 1) & (requestCapacity - 1); requestTable[next].request != NULL; next=(next + 1) & (requestCapacity - 1)) {
+        home = requestHome(requestTable[next].request);
+        // The request can move to the free slot if its home is not between the free slot and it
+        if ((next > slot && (home <= slot || home > next)) || (next < slot && home <= slot && home > next)) {
+            requestTable[slot] = requestTable[next];
+            requestTable[next].request = NULL;
+            slot = next;
+        }
+    }
+}
+
+/**
+ * @brief Count the requests a completion call completed by their tags, the seconds of the call are shared out
+ * over them. A call that completes none of the requests in the table is counted without a tag.
+ * @param[in] call
+ * @param[in] requests
+ * The requests the caller passed to the call
+ * @param[in] indices
+ * The indices of the requests that completed, or NULL if the first count requests completed
+ * @param[in] statuses
+ * The statuses of the requests that completed
+ * @param[in] count
+ * The number of requests that completed
+ * @param[in] start
+ *
+ */
+static void completeRequests(int call, MPI_Request requests[], int indices[], MPI_Status * statuses, int count,
+                             double start){
+    int i, slot, completed = 0, received, tag;
+    long bytes;
+    MPI_Request * request;
+    double seconds = MPI_Wtime() - start;
+
+    for (i=0; i<count; i++) {
+        slot = requestSlot(&requests[indices == NULL ? i : indices[i]]);
+        if (slot >= 0 && requestTable[slot].active)
+            completed++;
+    }
+    if (completed == 0) {
+        addCall(call, MPI_ANY_TAG, 0, seconds);
+        return;
+    }
+
+    for (i=0; i<count; i++) {
+        request = &requests[indices == NULL ? i : indices[i]];
+        slot = requestSlot(request);
+        if (slot < 0 || !requestTable[slot].active)
+            continue;
+
+        tag = requestTable[slot].tag;
+        bytes = 0;
+        if (requestTable[slot].receive) {
+            // The tag and the size of the message that came, whatever the receive asked for
+            PMPI_Get_count(&statuses[i], requestTable[slot].datatype, &received);
+            if (received != MPI_UNDEFINED)
+                bytes = messageBytes(received, requestTable[slot].datatype);
+            if (tag == MPI_ANY_TAG)
+                tag = statuses[i].MPI_TAG;
+        }
+        addCall(call, tag, bytes, seconds / completed);
+
+        // A persistent request stays until it is freed, the others are done
+        if (*request == MPI_REQUEST_NULL)
+            forgetRequest(request);
+        else
+            requestTable[slot].active = 0;
+    }
+}
+
+/**
+ * @brief The statuses a completion call fills in, the caller's or the profile's own if the caller ignores them
+ * @param[in] statuses
+ * @param[in] count
+ * @return The statuses
+ *
+ */
+static MPI_Status * statusesFor(MPI_Status * statuses, int count){
+    if (statuses != MPI_STATUSES_IGNORE && statuses != MPI_STATUS_IGNORE)
+        return statuses;
+
+    if (count > profileStatusCount) {
+        free(profileStatuses);
+        profileStatuses = (MPI_Status *) malloc(sizeof(MPI_Status) * count);
+        if (profileStatuses == NULL) {
+            fprintf(stderr, "[Profile] Can not allocate %d statuses\n", count);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        profileStatusCount = count;
+    }
+    return profileStatuses;
+}
+
+/** ========= The PMPI wrappers, every call of the simulation and the pool goes through them ========= **/
+
+int MPI_Send(const void * buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Send(buf, count, datatype, dest, tag, comm);
+    recordCall(PROFILE_SEND, tag, messageBytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Isend(const void * buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm, MPI_Request * request){
+    double start = profileStart();
+    int result = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+    if (profileEnabled) {
+        recordCall(PROFILE_ISEND, tag, messageBytes(count, datatype), start);
+        trackRequest(request, tag, 0, 0, datatype, 1);
+    }
+    return result;
+}
+
+int MPI_Send_init(const void * buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+                  MPI_Request * request){
+    double start = profileStart();
+    int result = PMPI_Send_init(buf, count, datatype, dest, tag, comm, request);
+    if (profileEnabled) {
+        recordCall(PROFILE_SEND_INIT, tag, 0, start);
+        trackRequest(request, tag, 0, messageBytes(count, datatype), datatype, 0);
+    }
+    return result;
+}
+
+int MPI_Recv_init(void * buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Request * request){
+    double start = profileStart();
+    int result = PMPI_Recv_init(buf, count, datatype, source, tag, comm, request);
+    if (profileEnabled) {
+        recordCall(PROFILE_RECV_INIT, tag, 0, start);
+        trackRequest(request, tag, 1, 0, datatype, 0);
+    }
+    return result;
+}
+
+int MPI_Recv(void * buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status * status){
+    MPI_Status received;
+    double start = profileStart();
+    int result = PMPI_Recv(buf, count, datatype, source, tag, comm, &received);
+
+    // The tag and the size of the message that came, whatever the caller asked for
+    if (profileEnabled) {
+        PMPI_Get_count(&received, datatype, &count);
+        recordCall(PROFILE_RECV, received.MPI_TAG, messageBytes(count, datatype), start);
+    }
+    if (status != MPI_STATUS_IGNORE)
+        *status = received;
+    return result;
+}
+
+int MPI_Irecv(void * buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Request * request){
+    double start = profileStart();
+    int result = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+    if (profileEnabled) {
+        recordCall(PROFILE_IRECV, tag, 0, start);
+        trackRequest(request, tag, 1, 0, datatype, 1);
+    }
+    return result;
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status * status){
+    MPI_Status probed;
+    double start = profileStart();
+    int result = PMPI_Probe(source, tag, comm, &probed);
+
+    recordCall(PROFILE_PROBE, probed.MPI_TAG, 0, start);
+    if (status != MPI_STATUS_IGNORE)
+        *status = probed;
+    return result;
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int * flag, MPI_Status * status){
+    double start = profileStart();
+    int result = PMPI_Iprobe(source, tag, comm, flag, status);
+    recordCall(PROFILE_IPROBE, tag, 0, start);
+    return result;
+}
+
+int MPI_Start(MPI_Request * request){
+    int slot;
+    double start = profileStart();
+    int result = PMPI_Start(request);
+    if (!profileEnabled)
+        return result;
+
+    // A persistent send sends its bytes each time it starts
+    slot = requestSlot(request);
+    if (slot < 0) {
+        recordCall(PROFILE_START, MPI_ANY_TAG, 0, start);
+        return result;
+    }
+    recordCall(PROFILE_START, requestTable[slot].tag, requestTable[slot].receive ? 0 : requestTable[slot].bytes, start);
+    requestTable[slot].active = 1;
+    return result;
+}
+
+int MPI_Request_free(MPI_Request * request){
+    double start = profileStart();
+    int result = PMPI_Request_free(request);
+    if (profileEnabled) {
+        recordCall(PROFILE_REQUEST_FREE, MPI_ANY_TAG, 0, start);
+        forgetRequest(request);
+    }
+    return result;
+}
+
+int MPI_Wait(MPI_Request * request, MPI_Status * status){
+    double start = profileStart();
+    int result;
+    if (!profileEnabled)
+        return PMPI_Wait(request, status);
+
+    status = statusesFor(status, 1);
+    result = PMPI_Wait(request, status);
+    completeRequests(PROFILE_WAIT, request, NULL, status, 1, start);
+    return result;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]){
+    double start = profileStart();
+    int result;
+    if (!profileEnabled)
+        return PMPI_Waitall(count, requests, statuses);
+
+    statuses = statusesFor(statuses, count);
+    result = PMPI_Waitall(count, requests, statuses);
+    completeRequests(PROFILE_WAITALL, requests, NULL, statuses, count, start);
+    return result;
+}
+
+int MPI_Waitsome(int incount, MPI_Request requests[], int * outcount, int indices[], MPI_Status statuses[]){
+    double start = profileStart();
+    int result;
+    if (!profileEnabled)
+        return PMPI_Waitsome(incount, requests, outcount, indices, statuses);
+
+    statuses = statusesFor(statuses, incount);
+    result = PMPI_Waitsome(incount, requests, outcount, indices, statuses);
+    completeRequests(PROFILE_WAITSOME, requests, indices, statuses, *outcount == MPI_UNDEFINED ? 0 : *outcount, start);
+    return result;
+}
+
+int MPI_Test(MPI_Request * request, int * flag, MPI_Status * status){
+    double start = profileStart();
+    int result;
+    if (!profileEnabled)
+        return PMPI_Test(request, flag, status);
+
+    status = statusesFor(status, 1);
+    result = PMPI_Test(request, flag, status);
+    completeRequests(PROFILE_TEST, request, NULL, status, *flag ? 1 : 0, start);
+    return result;
+}
+
+int MPI_Testall(int count, MPI_Request requests[], int * flag, MPI_Status statuses[]){
+    double start = profileStart();
+    int result;
+    if (!profileEnabled)
+        return PMPI_Testall(count, requests, flag, statuses);
+
+    statuses = statusesFor(statuses, count);
+    result = PMPI_Testall(count, requests, flag, statuses);
+    completeRequests(PROFILE_TESTALL, requests, NULL, statuses, *flag ? count : 0, start);
+    return result;
+}
+
+int MPI_Bcast(void * buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Bcast(buffer, count, datatype, root, comm);
+    recordCall(PROFILE_BCAST, MPI_ANY_TAG, messageBytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Barrier(MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Barrier(comm);
+    recordCall(PROFILE_BARRIER, MPI_ANY_TAG, 0, start);
+    return result;
+}
+
+int MPI_Reduce(const void * sendbuf, void * recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+    recordCall(PROFILE_REDUCE, MPI_ANY_TAG, messageBytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Ireduce(const void * sendbuf, void * recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root,
+                MPI_Comm comm, MPI_Request * request){
+    double start = profileStart();
+    int result = PMPI_Ireduce(sendbuf, recvbuf, count, datatype, op, root, comm, request);
+    if (profileEnabled) {
+        recordCall(PROFILE_IREDUCE, MPI_ANY_TAG, messageBytes(count, datatype), start);
+        trackRequest(request, MPI_ANY_TAG, 0, 0, datatype, 1);
+    }
+    return result;
+}
+
+int MPI_Allreduce(const void * sendbuf, void * recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+    recordCall(PROFILE_ALLREDUCE, MPI_ANY_TAG, messageBytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Gather(const void * sendbuf, int sendcount, MPI_Datatype sendtype, void * recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    recordCall(PROFILE_GATHER, MPI_ANY_TAG, messageBytes(sendcount, sendtype), start);
+    return result;
+}
+
+int MPI_Allgather(const void * sendbuf, int sendcount, MPI_Datatype sendtype, void * recvbuf, int recvcount,
+                  MPI_Datatype recvtype, MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    recordCall(PROFILE_ALLGATHER, MPI_ANY_TAG, messageBytes(sendcount, sendtype), start);
+    return result;
+}
+
+int MPI_Exscan(const void * sendbuf, void * recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm){
+    double start = profileStart();
+    int result = PMPI_Exscan(sendbuf, recvbuf, count, datatype, op, comm);
+    recordCall(PROFILE_EXSCAN, MPI_ANY_TAG, messageBytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Win_lock(int lock_type, int rank, int assert, MPI_Win win){
+    double start = profileStart();
+    int result = PMPI_Win_lock(lock_type, rank, assert, win);
+    recordCall(PROFILE_WIN_LOCK, MPI_ANY_TAG, 0, start);
+    return result;
+}
+
+int MPI_Win_unlock(int rank, MPI_Win win){
+    double start = profileStart();
+    int result = PMPI_Win_unlock(rank, win);
+    recordCall(PROFILE_WIN_UNLOCK, MPI_ANY_TAG, 0, start);
+    return result;
+}
+
+int MPI_Win_flush(int rank, MPI_Win win){
+    double start = profileStart();
+    int result = PMPI_Win_flush(rank, win);
+    recordCall(PROFILE_WIN_FLUSH, MPI_ANY_TAG, 0, start);
+    return result;
+}
+
+int MPI_Put(const void * origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank,
+            MPI_Aint target_disp, int target_count, MPI_Datatype target_datatype, MPI_Win win){
+    double start = profileStart();
+    int result = PMPI_Put(origin_addr, origin_count, origin_datatype, target_rank, target_disp, target_count,
+                          target_datatype, win);
+    recordCall(PROFILE_PUT, MPI_ANY_TAG, messageBytes(origin_count, origin_datatype), start);
+    return result;
+}
+
+int MPI_Get(void * origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank, MPI_Aint target_disp,
+            int target_count, MPI_Datatype target_datatype, MPI_Win win){
+    double start = profileStart();
+    int result = PMPI_Get(origin_addr, origin_count, origin_datatype, target_rank, target_disp, target_count,
+                          target_datatype, win);
+    recordCall(PROFILE_GET, MPI_ANY_TAG, messageBytes(origin_count, origin_datatype), start);
+    return result;
+}
+
+int MPI_Get_accumulate(const void * origin_addr, int origin_count, MPI_Datatype origin_datatype, void * result_addr,
+                       int result_count, MPI_Datatype result_datatype, int target_rank, MPI_Aint target_disp,
+                       int target_count, MPI_Datatype target_datatype, MPI_Op op, MPI_Win win){
+    double start = profileStart();
+    int result = PMPI_Get_accumulate(origin_addr, origin_count, origin_datatype, result_addr, result_count,
+                                     result_datatype, target_rank, target_disp, target_count, target_datatype, op, win);
+    // The bytes that go to the target and the bytes that come back
+    recordCall(PROFILE_GET_ACCUMULATE, MPI_ANY_TAG,
+               messageBytes(origin_count, origin_datatype) + messageBytes(result_count, result_datatype), start);
+    return result;
+}
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include "mpi.h"
 #include "../include/pool.h"
 
@@ -7,50 +8,132 @@
 #define PP_CONTROL_TAG 16384
 #define PP_PID_TAG 16383
 
-// Pool options
-#define PP_QuitOnNoProcs 1
+// Pool options, what to do with a start request when there is no idle process (set one of them)
+#define PP_QuitOnNoProcs 0
 #define PP_IgnoreOnNoProcs 0
+#define PP_QueueOnNoProcs 1
 #define PP_DEBUG 0
 
+// Sub-masters, each one owns the idle workers of its group and only goes to the master when they are all busy.
+// The master owns the workers of its own group. Set one of them, a sub-master is a process taken from the workers
+#define PP_SubMastersPerNode 0		// 1 for a group per node
+#define PP_SubMasterGroupSize 0		// Or groups of this many ranks, e.g. to try sub-masters on one node
+
 // Example command package data type which can be extended
 static MPI_Datatype PP_COMMAND_TYPE;
 
+// A set of ranks, a summary word covers 4096 ranks so the lowest one is a couple of find first set instructions
+struct PP_Bitmap {
+	uint64_t* bits;
+	uint64_t* summary;
+	int words;
+};
+
 // Internal pool global state
+static MPI_Comm PP_comm=MPI_COMM_WORLD;	// The processes of the pool, the ranks are the ones in it
 static int PP_myRank;
 static int PP_numProcs;
-static char* PP_active=NULL;
-static int PP_processesAwaitingStart;
+static int* PP_masterOf=NULL;			// The master or sub-master of each rank, a sub-master is its own
+static int PP_masterRank;				// The master or sub-master of this rank
+static struct PP_Bitmap PP_idle;		// The idle workers of the group of this master or sub-master
+static struct PP_Bitmap PP_idleGroups;	// The sub-masters with idle workers as far as the master knows
+static int PP_groupHasIdle;				// What this sub-master last told the master
+static int* PP_startQueue=NULL;		// The ranks waiting for a worker to start, oldest first
+static int PP_startQueueHead;
+static int PP_startQueueCount;
+static int PP_planned=0;
+static int* PP_awakeRanks=NULL;		// The workers that are awake when the pool starts, in rank order
+static int PP_awakeCount=0;
+static int PP_awakeIndex=-1;			// The place of this rank in them, or -1
 static struct PP_Control_Package in_command;
 static MPI_Request PP_pollRecvCommandRequest = MPI_REQUEST_NULL;
 
 // Internal pool functions
 static void errorMessage(char*);
-static int startAwaitingProcessesIfNeeded(int, int);
+static void findMasters();
+static void initialiseMasterState();
+static void freeMasterState();
+static void subMasterLoop();
+static void reportGroupState(int);
+static void masterStartProcess(int);
+static void forwardStartRequest(int, int);
+static void bitmapInit(struct PP_Bitmap*, int);
+static void bitmapFree(struct PP_Bitmap*);
+static void bitmapSet(struct PP_Bitmap*, int, int);
+static int bitmapFirst(struct PP_Bitmap*);
+static int startProcess(int);
+static void parkStartRequest(int);
+static int popStartRequest();
 static int handleRecievedCommand();
 static void initialiseType();
 static struct PP_Control_Package createCommandPackage(enum PP_Control_Command);
 
+/**
+ * Runs the pool on the processes of comm instead of all of them, call it before processPoolPlan. The pool only
+ * keeps the communicator, the caller frees it after processPoolFinalise
+ */
+void processPoolSetComm(MPI_Comm comm) {
+	PP_comm=comm;
+}
+
+/**
+ * Plans the pool, collective over the processes of the pool. The first count workers in rank order, sub-masters left out,
+ * are awake when the pool starts: they return from processPoolInit as if the master had started them, without any
+ * message, and every process knows their ranks from getAwakeWorkerRank. processPoolInit plans the pool with no
+ * awake workers if this has not been called
+ */
+void processPoolPlan(int count) {
+	int i;
+	initialiseType();
+	MPI_Comm_rank(PP_comm, &PP_myRank);
+	MPI_Comm_size(PP_comm, &PP_numProcs);
+	findMasters();
+	PP_awakeRanks=(int*) malloc(sizeof(int)*(count > 0 ? count : 1));
+	if (PP_awakeRanks == NULL) errorMessage("Can not allocate the awake workers of the pool");
+	PP_awakeCount=0;
+	for(i=1;i<PP_numProcs && PP_awakeCount<count;i++) {
+		if (PP_masterOf[i] == i) continue;
+		if (i == PP_myRank) PP_awakeIndex=PP_awakeCount;
+		PP_awakeRanks[PP_awakeCount++]=i;
+	}
+	if (PP_awakeCount < count) errorMessage("Not enough worker processes for the workers awake at start");
+	PP_planned=1;
+}
+
+/**
+ * The rank of the index-th worker that is awake when the pool starts, the same on every process
+ */
+int getAwakeWorkerRank(int index) {
+	return PP_awakeRanks[index];
+}
+
 /**
  * Initialises the processes pool. Note that a worker will not return from this until it has been instructed to do some work
  * or quit. The return code zero indicates quit, one indicates loop and work for the worker and two indicates that this is the
  * master and it should loop and call master pool.
  */
 int processPoolInit() {
-	initialiseType();
-	MPI_Comm_rank(MPI_COMM_WORLD, &PP_myRank);
-	MPI_Comm_size(MPI_COMM_WORLD, &PP_numProcs);
+	if (!PP_planned) processPoolPlan(0);
 	if (PP_myRank == 0) {
 		if(PP_numProcs < 2){
 			errorMessage("No worker processes available for pool, run with more than one MPI process");
 		}
-		PP_active=(char*) malloc(PP_numProcs);
-		int i;
-		for(i=0;i<PP_numProcs-1;i++) PP_active[i]=0;
-		PP_processesAwaitingStart=0;
+		initialiseMasterState();
 		if (PP_DEBUG) printf("[Master] Initialised Master\n");
 		return 2;
+	} else if (PP_masterRank == PP_myRank) {
+		// A sub-master serves its group until the pool stops, then quits like a worker
+		initialiseMasterState();
+		subMasterLoop();
+		freeMasterState();
+		return 0;
+	} else if (PP_awakeIndex >= 0) {
+		// Started by the master at the start of the pool, without a message
+		in_command=createCommandPackage(PP_WAKE);
+		in_command.data=0;
+		return handleRecievedCommand();
 	} else {
-		MPI_Recv(&in_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Recv(&in_command, 1, PP_COMMAND_TYPE, PP_masterRank, PP_CONTROL_TAG, PP_comm, MPI_STATUS_IGNORE);
 		return handleRecievedCommand();
 	}
 }
@@ -60,15 +143,19 @@ int processPoolInit() {
  */
 void processPoolFinalise() {
 	if (PP_myRank == 0) {
-		if (PP_active != NULL) free(PP_active);
+		freeMasterState();
 		int i;
-		for(i=0;i<PP_numProcs-1;i++) {
+		for(i=1;i<PP_numProcs;i++) {
+			// The sub-masters stop the workers of their groups
+			if (PP_masterOf[i] != 0 && PP_masterOf[i] != i) continue;
 			if (PP_DEBUG) printf("[Master] Shutting down process %d\n", i);
 			struct PP_Control_Package out_command = createCommandPackage(PP_STOP);
-			MPI_Send(&out_command, 1, PP_COMMAND_TYPE, i+1, PP_CONTROL_TAG, MPI_COMM_WORLD);
+			MPI_Send(&out_command, 1, PP_COMMAND_TYPE, i, PP_CONTROL_TAG, PP_comm);
 		}
 	}
-	MPI_Barrier(MPI_COMM_WORLD);
+	MPI_Barrier(PP_comm);
+	free(PP_masterOf);
+	free(PP_awakeRanks);
 	MPI_Type_free(&PP_COMMAND_TYPE);
 }
 
@@ -79,11 +166,13 @@ void processPoolFinalise() {
 int masterPoll() {
 	if (PP_myRank == 0) {
 		MPI_Status status;
-		MPI_Recv(&in_command, 1, PP_COMMAND_TYPE, MPI_ANY_SOURCE, PP_CONTROL_TAG, MPI_COMM_WORLD, &status) ;
+		MPI_Recv(&in_command, 1, PP_COMMAND_TYPE, MPI_ANY_SOURCE, PP_CONTROL_TAG, PP_comm, &status) ;
 
 		if(in_command.command==PP_SLEEPING) {
 			if (PP_DEBUG) printf("[Master] Received sleep command from %d\n", status.MPI_SOURCE);
-			PP_active[status.MPI_SOURCE-1]=0;
+			bitmapSet(&PP_idle, status.MPI_SOURCE, 1);
+			// The process goes straight to the oldest parked request
+			if (PP_startQueueCount) masterStartProcess(popStartRequest());
 		}
 
 		if(in_command.command==PP_RUNCOMPLETE){
@@ -92,14 +181,13 @@ int masterPoll() {
 		}
 
 		if(in_command.command==PP_STARTPROCESS) {
-			PP_processesAwaitingStart++;
+			// A sub-master passes on the request of a worker of its group when the group has no idle process
+			masterStartProcess(PP_masterOf[status.MPI_SOURCE] == status.MPI_SOURCE ? in_command.data : status.MPI_SOURCE);
 		}
 
-		int returnRank = startAwaitingProcessesIfNeeded(PP_processesAwaitingStart, status.MPI_SOURCE);
-
-		if(in_command.command==PP_STARTPROCESS) {
-			// If the master was to start a worker then send back the process rank that this worker is now on
-			MPI_Send(&returnRank, 1, MPI_INT, status.MPI_SOURCE, PP_PID_TAG, MPI_COMM_WORLD);
+		if(in_command.command==PP_GROUPSTATE) {
+			bitmapSet(&PP_idleGroups, status.MPI_SOURCE, in_command.data);
+			if (in_command.data && PP_startQueueCount) forwardStartRequest(status.MPI_SOURCE, popStartRequest());
 		}
 		return 1;
 	} else {
@@ -113,15 +201,27 @@ int masterPoll() {
  */
 int startWorkerProcess() {
 	if (PP_myRank == 0) {
-		PP_processesAwaitingStart++;
-		return startAwaitingProcessesIfNeeded(PP_processesAwaitingStart, 0);
+		int workerRank=startProcess(0), group, reply[2];
+		if (workerRank >= 0) return workerRank;
+
+		group=bitmapFirst(&PP_idleGroups);
+		if (group >= 0) {
+			// The sub-master replies with the rank and whether its group has idle processes left
+			forwardStartRequest(group, 0);
+			MPI_Recv(reply, 2, MPI_INT, group, PP_PID_TAG, PP_comm, MPI_STATUS_IGNORE);
+			bitmapSet(&PP_idleGroups, group, reply[1]);
+			return reply[0];
+		}
+		// The master can not wait for a process to go to sleep, it is the one that would see it
+		if (!PP_IgnoreOnNoProcs) errorMessage("No more processes available for the master");
+		return -1;
 	} else {
 		int workerRank;
 		struct PP_Control_Package out_command = createCommandPackage(PP_STARTPROCESS);
-		MPI_Send(&out_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, MPI_COMM_WORLD);
-		// Receive the rank that this worker has been placed on - if you change the default option from aborting when
-		// there are not enough MPI processes then this may be -1
-		MPI_Recv(&workerRank, 1, MPI_INT, 0, PP_PID_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		MPI_Send(&out_command, 1, PP_COMMAND_TYPE, PP_masterRank, PP_CONTROL_TAG, PP_comm);
+		// Receive the rank that this worker has been placed on - this may be -1 with PP_IgnoreOnNoProcs, and it may
+		// take until a process goes to sleep with PP_QueueOnNoProcs. The master or any sub-master can answer
+		MPI_Recv(&workerRank, 1, MPI_INT, MPI_ANY_SOURCE, PP_PID_TAG, PP_comm, MPI_STATUS_IGNORE);
 		return workerRank;
 	}
 }
@@ -134,7 +234,7 @@ void shutdownPool() {
 	if (PP_myRank != 0) {
 		if (PP_DEBUG) printf("[Worker] Commanding a pool shutdown\n");
 		struct PP_Control_Package out_command = createCommandPackage(PP_RUNCOMPLETE);
-		MPI_Send(&out_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, MPI_COMM_WORLD);
+		MPI_Send(&out_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, PP_comm);
 	}
 }
 
@@ -148,7 +248,7 @@ int workerSleep() {
 		if (in_command.command==PP_WAKE) {
 			// The command was to wake up, it has done the work and now it needs to switch to sleeping mode
 			struct PP_Control_Package out_command = createCommandPackage(PP_SLEEPING);
-			MPI_Send(&out_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, MPI_COMM_WORLD);
+			MPI_Send(&out_command, 1, PP_COMMAND_TYPE, PP_masterRank, PP_CONTROL_TAG, PP_comm);
 			if (PP_pollRecvCommandRequest != MPI_REQUEST_NULL) MPI_Wait(&PP_pollRecvCommandRequest, MPI_STATUS_IGNORE);
 		}
 		return handleRecievedCommand();
@@ -182,45 +282,265 @@ int shouldWorkerStop() {
 }
 
 /**
- * Called by the master and will start awaiting processes (signal to them to start) if required.
- * By default this works as a process pool, so if there are not enough processes to workers then it will quit
- * but this can be changed by modifying options in the pool.
- * It takes in the awaiting worker number to send rank data to/from, the parent rank of the process to start
- * and returns the process rank that this awaiting worker was on. In the default case of #workers > pool capacity
- * causing an abort, then this will only be called to start single workers and as such the parent ID and return rank
- * will match perfectly. If you change the options to allow for workers to queue up if there is not enough MPI
- * capacity then the parent and return rank will be -1 for all workers started which do not match the provided awaiting Id
+ * Finds the master or sub-master of every rank, collective over the processes of the pool. Without sub-masters the master
+ * is the master of all the ranks
  */
-static int startAwaitingProcessesIfNeeded(int awaitingId, int parent) {
-	int awaitingProcessMPIRank=-1;
-	if(PP_processesAwaitingStart) {
-		int i;
-		for(i=0;i<PP_numProcs-1;i++){
-			if(!PP_active[i]) {
-				PP_active[i]=1;
-				struct PP_Control_Package out_command = createCommandPackage(PP_WAKE);
-				out_command.data = awaitingId == PP_processesAwaitingStart ? parent : -1;
-				if (PP_DEBUG) printf("[Master] Starting process %d\n", i+1);
-				MPI_Send(&out_command, 1, PP_COMMAND_TYPE, i+1, PP_CONTROL_TAG, MPI_COMM_WORLD);
-				if (awaitingId == PP_processesAwaitingStart) awaitingProcessMPIRank = i+1;	// Will return this rank to the caller
-				PP_processesAwaitingStart--;
-				if (PP_processesAwaitingStart == 0) break;
+static void findMasters() {
+	int master=0;
+	if (PP_SubMastersPerNode) {
+		// The lowest rank of a node is its sub-master, the master's node is the master's group
+		MPI_Comm node;
+		MPI_Comm_split_type(PP_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+		MPI_Allreduce(&PP_myRank, &master, 1, MPI_INT, MPI_MIN, node);
+		MPI_Comm_free(&node);
+	} else if (PP_SubMasterGroupSize > 0) {
+		master=PP_myRank-PP_myRank%(PP_SubMasterGroupSize > 0 ? PP_SubMasterGroupSize : 1);
+	}
+	PP_masterOf=(int*) malloc(sizeof(int)*PP_numProcs);
+	if (PP_masterOf == NULL) errorMessage("Can not allocate the masters of the pool");
+	MPI_Allgather(&master, 1, MPI_INT, PP_masterOf, 1, MPI_INT, PP_comm);
+	PP_masterRank=master;
+}
+
+/**
+ * Initialises the idle workers of the group of this master or sub-master, and on the master the sub-masters
+ * with idle workers
+ */
+static void initialiseMasterState() {
+	int i;
+	char* awake=(char*) calloc(PP_numProcs, 1);
+	bitmapInit(&PP_idle, PP_numProcs);
+	bitmapInit(&PP_idleGroups, PP_numProcs);
+	PP_startQueue=(int*) malloc(sizeof(int)*PP_numProcs);
+	if (PP_startQueue == NULL || awake == NULL) errorMessage("Can not allocate the state of the pool");
+	for(i=0;i<PP_awakeCount;i++) awake[PP_awakeRanks[i]]=1;
+	for(i=0;i<PP_numProcs;i++) {
+		if (i == PP_myRank || PP_masterOf[i] == i || awake[i]) continue;
+		if (PP_masterOf[i] == PP_myRank) bitmapSet(&PP_idle, i, 1);
+		// All the workers but the awake ones are idle at first
+		if (PP_myRank == 0) bitmapSet(&PP_idleGroups, PP_masterOf[i], PP_masterOf[i] != 0);
+	}
+	free(awake);
+	PP_groupHasIdle=bitmapFirst(&PP_idle) >= 0;
+	PP_startQueueHead=0;
+	PP_startQueueCount=0;
+}
+
+/**
+ * Releases the state of the master or sub-master
+ */
+static void freeMasterState() {
+	if (PP_startQueueCount) fprintf(stderr,"[ProcessPool] Warning. %d start requests never got a process.\n", PP_startQueueCount);
+	bitmapFree(&PP_idle);
+	bitmapFree(&PP_idleGroups);
+	free(PP_startQueue);
+	PP_startQueue=NULL;
+}
+
+/**
+ * The loop of a sub-master. It starts the workers of its group for the requests of the group, passes the requests
+ * on to the master when the group has no idle process, and starts workers for the requests the master passes on to
+ * it. It tells the master when its group runs out of idle processes and when it has some again
+ */
+static void subMasterLoop() {
+	int parent, workerRank, reply[2];
+	MPI_Status status;
+	while (1) {
+		MPI_Recv(&in_command, 1, PP_COMMAND_TYPE, MPI_ANY_SOURCE, PP_CONTROL_TAG, PP_comm, &status);
+
+		if (in_command.command==PP_STOP) {
+			int i;
+			for(i=0;i<PP_numProcs;i++) {
+				if (i == PP_myRank || PP_masterOf[i] != PP_myRank) continue;
+				struct PP_Control_Package out_command = createCommandPackage(PP_STOP);
+				MPI_Send(&out_command, 1, PP_COMMAND_TYPE, i, PP_CONTROL_TAG, PP_comm);
 			}
-			if(i==PP_numProcs-2){
-				//If I reach this point, I must have looped through the whole array and found no available processes
-				if(PP_QuitOnNoProcs) {
-					errorMessage("No more processes available");
-				}
+			return;
+		}
 
-				if(PP_IgnoreOnNoProcs) {
-					fprintf(stderr,"[ProcessPool] Warning. No processes available. Ignoring launch request.\n");
-					PP_processesAwaitingStart--;
+		if (in_command.command==PP_SLEEPING) {
+			bitmapSet(&PP_idle, status.MPI_SOURCE, 1);
+			if (PP_startQueueCount) {
+				// Only the requests passed on by the master are parked here
+				parent=popStartRequest();
+				workerRank=startProcess(parent);
+				if (parent == 0) {
+					reply[0]=workerRank;
+					reply[1]=PP_groupHasIdle=bitmapFirst(&PP_idle) >= 0;
+					MPI_Send(reply, 2, MPI_INT, 0, PP_PID_TAG, PP_comm);
+				} else {
+					MPI_Send(&workerRank, 1, MPI_INT, parent, PP_PID_TAG, PP_comm);
+					reportGroupState(1);
 				}
-				// otherwise, do nothing; a process may become available on the next iteration of the loop
 			}
 		}
+
+		if (in_command.command==PP_STARTPROCESS && status.MPI_SOURCE == 0) {
+			parent=in_command.data;
+			workerRank=startProcess(parent);
+			if (workerRank < 0) {
+				// The group ran out of idle processes after it told the master it had some
+				parkStartRequest(parent);
+			} else if (parent == 0) {
+				reply[0]=workerRank;
+				reply[1]=PP_groupHasIdle=bitmapFirst(&PP_idle) >= 0;
+				MPI_Send(reply, 2, MPI_INT, 0, PP_PID_TAG, PP_comm);
+			} else {
+				MPI_Send(&workerRank, 1, MPI_INT, parent, PP_PID_TAG, PP_comm);
+			}
+			// The master waits for the state of the group before it passes on another request
+			if (parent != 0) reportGroupState(1);
+		} else if (in_command.command==PP_STARTPROCESS) {
+			workerRank=startProcess(status.MPI_SOURCE);
+			if (workerRank < 0) {
+				in_command.data=status.MPI_SOURCE;
+				MPI_Send(&in_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, PP_comm);
+			} else {
+				MPI_Send(&workerRank, 1, MPI_INT, status.MPI_SOURCE, PP_PID_TAG, PP_comm);
+			}
+		}
+
+		reportGroupState(0);
+	}
+}
+
+/**
+ * Tells the master whether the group of this sub-master has idle processes, if it changed or if always is set
+ */
+static void reportGroupState(int always) {
+	int hasIdle=bitmapFirst(&PP_idle) >= 0;
+	if (!always && hasIdle == PP_groupHasIdle) return;
+
+	PP_groupHasIdle=hasIdle;
+	struct PP_Control_Package out_command = createCommandPackage(PP_GROUPSTATE);
+	out_command.data = hasIdle;
+	MPI_Send(&out_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, PP_comm);
+}
+
+/**
+ * Called by the master to start a worker for the parent rank. It starts one of its own group, or passes the
+ * request on to a sub-master with idle processes, otherwise it does what the pool options say
+ */
+static void masterStartProcess(int parent) {
+	int workerRank=startProcess(parent), group;
+	if (workerRank < 0) {
+		group=bitmapFirst(&PP_idleGroups);
+		if (group >= 0) {
+			forwardStartRequest(group, parent);
+			return;
+		}
+		if(PP_QuitOnNoProcs) {
+			errorMessage("No more processes available");
+		}
+		if(PP_QueueOnNoProcs) {
+			// The caller waits for its rank until a process goes to sleep
+			parkStartRequest(parent);
+			return;
+		}
+		fprintf(stderr,"[ProcessPool] Warning. No processes available. Ignoring launch request.\n");
+	}
+	// If the master was to start a worker then send back the process rank that this worker is now on
+	MPI_Send(&workerRank, 1, MPI_INT, parent, PP_PID_TAG, PP_comm);
+}
+
+/**
+ * Called by the master to pass the start request of the parent rank on to a sub-master. The master does not pass
+ * on another one to it until the sub-master tells it whether it has idle processes left
+ */
+static void forwardStartRequest(int group, int parent) {
+	if (PP_DEBUG) printf("[Master] Passing the start request of %d on to %d\n", parent, group);
+	bitmapSet(&PP_idleGroups, group, 0);
+	struct PP_Control_Package out_command = createCommandPackage(PP_STARTPROCESS);
+	out_command.data = parent;
+	MPI_Send(&out_command, 1, PP_COMMAND_TYPE, group, PP_CONTROL_TAG, PP_comm);
+}
+
+/**
+ * Allocates an empty set of ranks from 0 to size-1
+ */
+static void bitmapInit(struct PP_Bitmap* bitmap, int size) {
+	bitmap->words=(size+63)/64;
+	bitmap->bits=(uint64_t*) calloc(bitmap->words, sizeof(uint64_t));
+	bitmap->summary=(uint64_t*) calloc((bitmap->words+63)/64, sizeof(uint64_t));
+	if (bitmap->bits == NULL || bitmap->summary == NULL) errorMessage("Can not allocate the state of the pool");
+}
+
+/**
+ * Releases a set of ranks
+ */
+static void bitmapFree(struct PP_Bitmap* bitmap) {
+	free(bitmap->bits);
+	free(bitmap->summary);
+	bitmap->bits=bitmap->summary=NULL;
+	bitmap->words=0;
+}
+
+/**
+ * Adds the rank to the set or removes it
+ */
+static void bitmapSet(struct PP_Bitmap* bitmap, int rank, int value) {
+	int word=rank/64;
+	uint64_t bit=(uint64_t) 1 << (rank%64);
+	if (value) {
+		bitmap->bits[word]|=bit;
+	} else {
+		bitmap->bits[word]&=~bit;
+	}
+	if (bitmap->bits[word]) {
+		bitmap->summary[word/64]|=(uint64_t) 1 << (word%64);
+	} else {
+		bitmap->summary[word/64]&=~((uint64_t) 1 << (word%64));
+	}
+}
+
+/**
+ * Returns the lowest rank of the set, or -1 if it is empty
+ */
+static int bitmapFirst(struct PP_Bitmap* bitmap) {
+	int i, word;
+	for(i=0;i<(bitmap->words+63)/64;i++){
+		if(bitmap->summary[i]) {
+			word=i*64+__builtin_ctzll(bitmap->summary[i]);
+			return word*64+__builtin_ctzll(bitmap->bits[word]);
+		}
 	}
-	return awaitingProcessMPIRank;
+	return -1;
+}
+
+/**
+ * Called by a master or sub-master to start an idle worker of its group for the parent rank, the parent rank is
+ * the data of the wake command. Returns the rank of the worker, or -1 if the group has no idle process
+ */
+static int startProcess(int parent) {
+	int rank=bitmapFirst(&PP_idle);
+	if (rank < 0) return -1;
+
+	bitmapSet(&PP_idle, rank, 0);
+	struct PP_Control_Package out_command = createCommandPackage(PP_WAKE);
+	out_command.data = parent;
+	if (PP_DEBUG) printf("[Master] Starting process %d\n", rank);
+	MPI_Send(&out_command, 1, PP_COMMAND_TYPE, rank, PP_CONTROL_TAG, PP_comm);
+	return rank;
+}
+
+/**
+ * Parks the start request of a worker until a process goes to sleep. A worker waits for the answer of its request,
+ * so there is one request per rank at most
+ */
+static void parkStartRequest(int parent) {
+	if (PP_DEBUG) printf("[Master] Parking the start request of %d\n", parent);
+	PP_startQueue[(PP_startQueueHead+PP_startQueueCount)%PP_numProcs]=parent;
+	PP_startQueueCount++;
+}
+
+/**
+ * Takes the oldest parked start request, returns its parent rank
+ */
+static int popStartRequest() {
+	int parent=PP_startQueue[PP_startQueueHead];
+	PP_startQueueHead=(PP_startQueueHead+1)%PP_numProcs;
+	PP_startQueueCount--;
+	return parent;
 }
 
 /**
@@ -230,7 +550,7 @@ static int handleRecievedCommand() {
 	// We have just (most likely) received a command, therefore decide what to do
 	if (in_command.command==PP_WAKE) {
 		// If we are told to wake then post a recv for the next command and return true to continues
-		MPI_Irecv(&in_command, 1, PP_COMMAND_TYPE, 0, PP_CONTROL_TAG, MPI_COMM_WORLD, &PP_pollRecvCommandRequest);
+		MPI_Irecv(&in_command, 1, PP_COMMAND_TYPE, PP_masterRank, PP_CONTROL_TAG, PP_comm, &PP_pollRecvCommandRequest);
 		if (PP_DEBUG) printf("[Worker] Process %d woken to work\n", PP_myRank);
 		return 1;
 	} else if (in_command.command == PP_STOP) {
@@ -256,12 +576,13 @@ static void errorMessage(char * message) {
  * the parent rank) can be associated with commands
  */
 static void initialiseType() {
-	struct PP_Control_Package package;
+	struct PP_Control_Package package = {PP_STOP, 0};
 	MPI_Aint pckAddress, dataAddress;
-	MPI_Address(&package, &pckAddress);
-	MPI_Address(&package.data, &dataAddress);
+	MPI_Get_address(&package, &pckAddress);
+	MPI_Get_address(&package.data, &dataAddress);
 	int blocklengths[3] = {1,1}, nitems=2;
-	MPI_Datatype types[3] = {MPI_CHAR, MPI_INT};
+	// The command is an enum, which is an int
+	MPI_Datatype types[3] = {MPI_INT, MPI_INT};
 	MPI_Aint offsets[3] = {0, dataAddress - pckAddress};
 	MPI_Type_create_struct(nitems, blocklengths, offsets, types, &PP_COMMAND_TYPE);
 	MPI_Type_commit(&PP_COMMAND_TYPE);
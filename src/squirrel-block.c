@@ -0,0 +1,162 @@
+#include <stdlib.h>
+
+#include "../include/config.h"
+#include "../include/actorConfig.h"
+#include "../include/squirrel-block.h"
+#include "../include/ring.h"
+
+/**
+ * Grows the arrays of the block so that it can hold at least capacity squirrels. The capacity at least doubles
+ * on each growth so appending squirrels one by one stays cheap. Returns 0 on success and -1 if the memory can
+ * not be allocated, in which case the block is left as it was.
+ */
+int reserveSquirrelBlock(struct SquirrelBlock * block, int capacity) {
+    if (capacity <= block->capacity) return 0;
+    if (capacity < SQUIRREL_BATCH_MIN_CAPACITY) capacity = SQUIRREL_BATCH_MIN_CAPACITY;
+    if (capacity < block->capacity * 2) capacity = block->capacity * 2;
+
+    uint64_t * id = (uint64_t *) realloc(block->id, sizeof(uint64_t) * capacity);
+    if (id != NULL) block->id = id;
+    float * x = (float *) realloc(block->x, sizeof(float) * capacity);
+    if (x != NULL) block->x = x;
+    float * y = (float *) realloc(block->y, sizeof(float) * capacity);
+    if (y != NULL) block->y = y;
+    int * state = (int *) realloc(block->state, sizeof(int) * capacity);
+    if (state != NULL) block->state = state;
+    int * steps = (int *) realloc(block->steps, sizeof(int) * capacity);
+    if (steps != NULL) block->steps = steps;
+    int * sickSteps = (int *) realloc(block->sickSteps, sizeof(int) * capacity);
+    if (sickSteps != NULL) block->sickSteps = sickSteps;
+    int * pop = (int *) realloc(block->pop, sizeof(int) * capacity * LAST_POPULATION_STEPS);
+    if (pop != NULL) block->pop = pop;
+    int * inf = (int *) realloc(block->inf, sizeof(int) * capacity * LAST_INFECTION_STEPS);
+    if (inf != NULL) block->inf = inf;
+    int * popSum = (int *) realloc(block->popSum, sizeof(int) * capacity);
+    if (popSum != NULL) block->popSum = popSum;
+    int * infSum = (int *) realloc(block->infSum, sizeof(int) * capacity);
+    if (infSum != NULL) block->infSum = infSum;
+
+    if (id == NULL || x == NULL || y == NULL || state == NULL || steps == NULL || sickSteps == NULL || pop == NULL || inf == NULL ||
+        popSum == NULL || infSum == NULL)
+        return -1;
+
+    block->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Releases the arrays of the block, the block is empty and can be reused afterwards
+ */
+void freeSquirrelBlock(struct SquirrelBlock * block) {
+    free(block->id);
+    free(block->x);
+    free(block->y);
+    free(block->state);
+    free(block->steps);
+    free(block->sickSteps);
+    free(block->pop);
+    free(block->inf);
+    free(block->popSum);
+    free(block->infSum);
+    block->id = NULL;
+    block->x = block->y = NULL;
+    block->state = block->steps = block->sickSteps = NULL;
+    block->pop = block->inf = NULL;
+    block->popSum = block->infSum = NULL;
+    block->count = 0;
+    block->capacity = 0;
+}
+
+/**
+ * Appends a new squirrel with the given id at (x, y) with the given state to the end of the block. The squirrel has not made
+ * any step yet and its population and infection windows are empty.
+ * Returns the index of the new squirrel in the block or -1 if the block can not grow
+ */
+int addSquirrelToBlock(struct SquirrelBlock * block, uint64_t id, float x, float y, int state) {
+    int i, k;
+
+    if (block->count == block->capacity && reserveSquirrelBlock(block, block->count + 1)) return -1;
+
+    i = block->count++;
+    block->id[i] = id;
+    block->x[i] = x;
+    block->y[i] = y;
+    block->state[i] = state;
+    block->steps[i] = 0;
+    block->sickSteps[i] = 0;
+    block->popSum[i] = 0;
+    block->infSum[i] = 0;
+
+    for (k=0; k<LAST_POPULATION_STEPS; k++)
+        block->pop[i * LAST_POPULATION_STEPS + k] = 0;
+
+    for (k=0; k<LAST_INFECTION_STEPS; k++)
+        block->inf[i * LAST_INFECTION_STEPS + k] = 0;
+
+    return i;
+}
+
+/**
+ * Compacts the block by moving the last squirrels into the slots of the dead (NOT_EXIST) ones. The order of
+ * the squirrels in the block is not kept. Returns the number of squirrels removed.
+ */
+int removeDeadSquirrelsFromBlock(struct SquirrelBlock * block) {
+    int i, last, k, removed;
+
+    i = 0;
+    removed = 0;
+    while (i < block->count) {
+        if (block->state[i] != NOT_EXIST) {
+            i++;
+            continue;
+        }
+
+        removed++;
+        last = --block->count;
+        if (i == last) break;
+
+        block->id[i] = block->id[last];
+        block->x[i] = block->x[last];
+        block->y[i] = block->y[last];
+        block->state[i] = block->state[last];
+        block->steps[i] = block->steps[last];
+        block->sickSteps[i] = block->sickSteps[last];
+        block->popSum[i] = block->popSum[last];
+        block->infSum[i] = block->infSum[last];
+
+        for (k=0; k<LAST_POPULATION_STEPS; k++)
+            block->pop[i * LAST_POPULATION_STEPS + k] = block->pop[last * LAST_POPULATION_STEPS + k];
+
+        for (k=0; k<LAST_INFECTION_STEPS; k++)
+            block->inf[i * LAST_INFECTION_STEPS + k] = block->inf[last * LAST_INFECTION_STEPS + k];
+    }
+    return removed;
+}
+
+/**
+ * Records the population influx and infection level the squirrel i got from the land in its current step. The
+ * oldest values of the windows are replaced and the running sums are kept with one add and one subtract each.
+ */
+void recordBlockVisit(struct SquirrelBlock * block, int i, int pop, int inf) {
+    int * oldPop = &block->pop[i * LAST_POPULATION_STEPS + RING_SLOT(block->steps[i], LAST_POPULATION_STEPS)];
+    int * oldInf = &block->inf[i * LAST_INFECTION_STEPS + RING_SLOT(block->steps[i], LAST_INFECTION_STEPS)];
+
+    block->popSum[i] += pop - *oldPop;
+    block->infSum[i] += inf - *oldInf;
+    *oldPop = pop;
+    *oldInf = inf;
+}
+
+/**
+ * Returns the average population influx in the window of the squirrel i of the block
+ */
+float getBlockAvgPop(struct SquirrelBlock * block, int i) {
+    return (float) block->popSum[i] / LAST_POPULATION_STEPS;
+}
+
+/**
+ * Returns the average infection level in the window of the squirrel i of the block
+ */
+float getBlockAvgInfLevel(struct SquirrelBlock * block, int i) {
+    return (float) block->infSum[i] / LAST_INFECTION_STEPS;
+}
@@ -3,69 +3,68 @@
 #include <stdlib.h>
 #include <time.h>
 
-#include "../include/ran2.h"
+#include "../include/config.h"
+#include "../include/squirrel-rng.h"
 #include "../include/squirrel-functions.h"
 
-/**
- * Initialises the random number generator, call it once at the start of the program on each process. The input
- * value should be negative, non-zero and different on each process, I suggest something like -1-rank where
- * rank is the MPI rank.
- * ran2 is a flawed RNG and must be used with particular care in parallel however it is perfectly sufficient
- * for this course work
- * The seed is modified and then passed to each other subsequent function that relies on the random generator,
- * which also modify the seed
- */
-void initialiseRNG(long *seed) {
-    ran2(seed);
-}
-
 /**
  * Simulates the step of a squirrel. You can call this with the arguments (0,0,&x,&y,&state)
  * to determine a random initial starting point.
- * x_new and y_new are the new x and y coordinates, state is used in the random number
- * generator and is also modified.
+ * x_new and y_new are the new x and y coordinates, state is the generator of the squirrel (see squirrel-rng.h)
+ * and moves on by two numbers.
  * x_new can point to x, and y_new can point to y
  */
-void squirrelStep(float x, float y, float* x_new, float* y_new, long * state){
+void squirrelStep(float x, float y, float* x_new, float* y_new, struct SquirrelRNG * state){
 
-    float diff=ran2(state);
-    *x_new=(x+diff)-(int)(x+diff);
+    float diff_x=squirrelRandom(state);
+    float diff_y=squirrelRandom(state);
+    squirrelStepBy(x, y, diff_x, diff_y, x_new, y_new);
+}
 
-    diff=ran2(state);
-    *y_new=(y+diff)-(int)(y+diff);
+/**
+ * Moves the squirrel by the random numbers diff_x and diff_y, this is what squirrelStep does with the first two
+ * numbers of the SQUIRREL_RNG_MOVE stream, use it with the numbers drawn in bulk by fillSquirrelRandom.
+ * x_new can point to x, and y_new can point to y
+ */
+void squirrelStepBy(float x, float y, float diff_x, float diff_y, float* x_new, float* y_new){
+    *x_new=(x+diff_x)-(int)(x+diff_x);
+    *y_new=(y+diff_y)-(int)(y+diff_y);
 }
 
 /**
- * Determines whether a squirrel will give birth or not based upon the average population and a random seed
- * which is modified. You can enclose this function call in an if statement if that is useful.
+ * Determines whether a squirrel will give birth or not based upon the average population and the generator
+ * of the squirrel, which moves on. You can enclose this function call in an if statement if that is useful.
  */
-int willGiveBirth(float avg_pop, long * state) {
+int willGiveBirth(float avg_pop, struct SquirrelRNG * state) {
     float probability=100.0; // Decrease this to make more likely, increase less likely
     float tmp=avg_pop/probability;
 
-    return (ran2(state)<(atan(tmp*tmp)/(4*tmp)));
+    return (squirrelRandom(state)<(atan(tmp*tmp)/(4*tmp)));
 }
 
 /**
  * Determines whether a squirrel will catch the disease or not based upon the average infection level
- * and a random seed which is modified. You can enclose this function call in an if statement if that is useful.
+ * and the generator of the squirrel, which moves on. You can enclose this function call in an if statement if that is useful.
  */
-int willCatchDisease(float avg_inf_level, long * state) {
+int willCatchDisease(float avg_inf_level, struct SquirrelRNG * state) {
     float probability=1000.0; // Decrease this to make more likely, increase less likely
-    return(ran2(state)<(atan(((avg_inf_level < 40000 ? avg_inf_level : 40000))/probability)/M_PI));
+    return(squirrelRandom(state)<(atan(((avg_inf_level < 40000 ? avg_inf_level : 40000))/probability)/M_PI));
 }
 
 /**
- * Determines if a squirrel will die or not. The state is used in the random number generation and
- * is modified. You can enclose this function call in an if statement if that is useful.
+ * Determines if a squirrel will die or not. The state is the generator of the squirrel, which
+ * moves on. You can enclose this function call in an if statement if that is useful.
  */
-int willDie(long * state) {
-    return(ran2(state)<(0.166666666));
+int willDie(struct SquirrelRNG * state) {
+    return(squirrelRandom(state)<(0.166666666));
 }
 
 /**
- * Returns the id of the cell from its x and y coordinates.
+ * Returns the id of the cell from its x and y coordinates. The land is a grid of LAND_WIDTH x LAND_HEIGHT cells
+ * numbered row by row, a coordinate that rounds up to the edge of the land is kept in the last cell.
  */
 int getCellFromPosition(float x, float y){
-    return((int)(x*4)+4*(int)(y*4));
+    int column=(int)(x*LAND_WIDTH);
+    int row=(int)(y*LAND_HEIGHT);
+    return((column < LAND_WIDTH ? column : LAND_WIDTH-1)+LAND_WIDTH*(row < LAND_HEIGHT ? row : LAND_HEIGHT-1));
 }
@@ -0,0 +1,255 @@
+#include <math.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "../include/squirrel-kernels.h"
+
+/*
+ * The kernels are built for AVX-512 when the compiler targets it (e.g. -mavx512f or -march=native), else for AVX2
+ * (-mavx2), else the scalar loops are used. The vector loops leave the squirrels after the last whole vector to the
+ * scalar loops. The versions do the same operations in the same order, the probabilities agree with the ones of
+ * squirrel-functions.c to the error of atanApprox.
+ */
+
+#define BIRTH_PROBABILITY 100.0f
+#define DISEASE_PROBABILITY 1000.0f
+#define DISEASE_MAX_LEVEL 40000.0f
+#define DIE_PROBABILITY 0.166666666f
+
+// Cephes atanf: the argument is reduced to |x| <= tan(pi/8) and a degree 9 odd polynomial is used
+#define ATAN_TAN_3PI_8 2.414213562373095f
+#define ATAN_TAN_PI_8 0.4142135623730950f
+#define ATAN_P0 8.05374449538e-2f
+#define ATAN_P1 -1.38776856032e-1f
+#define ATAN_P2 1.99777106478e-1f
+#define ATAN_P3 -3.33329491539e-1f
+#define PI_F 3.14159265358979f
+#define PI_2_F 1.57079632679490f
+#define PI_4_F 0.78539816339745f
+
+/**
+ * Returns the arc tangent of x with a relative error below 3e-7, a few units in the last place of a float.
+ * The kernels use the same reduction and polynomial on whole vectors.
+ */
+float atanApprox(float x) {
+    float ax = fabsf(x), y, z;
+
+    if (ax > ATAN_TAN_3PI_8) {
+        y = PI_2_F;
+        ax = -1.0f / ax;
+    } else if (ax > ATAN_TAN_PI_8) {
+        y = PI_4_F;
+        ax = (ax - 1.0f) / (ax + 1.0f);
+    } else {
+        y = 0.0f;
+    }
+
+    z = ax * ax;
+    y += (((ATAN_P0 * z + ATAN_P1) * z + ATAN_P2) * z + ATAN_P3) * z * ax + ax;
+    return x < 0 ? -y : y;
+}
+
+/**
+ * The probability of willGiveBirth for the average population avg_pop. It is NaN for avg_pop 0, which no random
+ * number is below, as in willGiveBirth.
+ */
+static float birthProbability(float avg_pop) {
+    float tmp = avg_pop * (1.0f / BIRTH_PROBABILITY);
+    return atanApprox(tmp * tmp) / (4 * tmp);
+}
+
+/**
+ * The probability of willCatchDisease for the average infection level avg_inf_level
+ */
+static float diseaseProbability(float avg_inf_level) {
+    float level = avg_inf_level < DISEASE_MAX_LEVEL ? avg_inf_level : DISEASE_MAX_LEVEL;
+    return atanApprox(level * (1.0f / DISEASE_PROBABILITY)) * (1.0f / PI_F);
+}
+
+#if defined(__AVX512F__)
+#define VECTOR_WIDTH 16
+
+static __m512 atanApproxVector(__m512 x) {
+    __m512 ax = _mm512_abs_ps(x);
+    __mmask16 big = _mm512_cmp_ps_mask(ax, _mm512_set1_ps(ATAN_TAN_3PI_8), _CMP_GT_OQ);
+    __mmask16 mid = _mm512_cmp_ps_mask(ax, _mm512_set1_ps(ATAN_TAN_PI_8), _CMP_GT_OQ) & ~big;
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512 y = _mm512_setzero_ps();
+    __m512 z, p;
+
+    y = _mm512_mask_blend_ps(mid, y, _mm512_set1_ps(PI_4_F));
+    y = _mm512_mask_blend_ps(big, y, _mm512_set1_ps(PI_2_F));
+    ax = _mm512_mask_blend_ps(mid, ax, _mm512_div_ps(_mm512_sub_ps(ax, one), _mm512_add_ps(ax, one)));
+    ax = _mm512_mask_blend_ps(big, ax, _mm512_div_ps(_mm512_set1_ps(-1.0f), ax));
+
+    z = _mm512_mul_ps(ax, ax);
+    p = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(ATAN_P0), z), _mm512_set1_ps(ATAN_P1));
+    p = _mm512_add_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(ATAN_P2));
+    p = _mm512_add_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(ATAN_P3));
+    y = _mm512_add_ps(y, _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(p, z), ax), ax));
+
+    // Put the sign of x back
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(y),
+            _mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x80000000))));
+}
+
+static void storeMask(unsigned char * mask, __mmask16 outcome) {
+    _mm_storeu_si128((__m128i *) mask, _mm512_cvtepi32_epi8(_mm512_maskz_set1_epi32(outcome, 1)));
+}
+
+#elif defined(__AVX2__)
+#define VECTOR_WIDTH 8
+
+static __m256 atanApproxVector(__m256 x) {
+    __m256 signBit = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(signBit, x);
+    __m256 big = _mm256_cmp_ps(ax, _mm256_set1_ps(ATAN_TAN_3PI_8), _CMP_GT_OQ);
+    __m256 mid = _mm256_andnot_ps(big, _mm256_cmp_ps(ax, _mm256_set1_ps(ATAN_TAN_PI_8), _CMP_GT_OQ));
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 y = _mm256_setzero_ps();
+    __m256 z, p;
+
+    y = _mm256_blendv_ps(y, _mm256_set1_ps(PI_4_F), mid);
+    y = _mm256_blendv_ps(y, _mm256_set1_ps(PI_2_F), big);
+    ax = _mm256_blendv_ps(ax, _mm256_div_ps(_mm256_sub_ps(ax, one), _mm256_add_ps(ax, one)), mid);
+    ax = _mm256_blendv_ps(ax, _mm256_div_ps(_mm256_set1_ps(-1.0f), ax), big);
+
+    z = _mm256_mul_ps(ax, ax);
+    p = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ATAN_P0), z), _mm256_set1_ps(ATAN_P1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(ATAN_P2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(ATAN_P3));
+    y = _mm256_add_ps(y, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, z), ax), ax));
+
+    // Put the sign of x back
+    return _mm256_or_ps(y, _mm256_and_ps(signBit, x));
+}
+
+static void storeMask(unsigned char * mask, __m256 outcome) {
+    int k, bits = _mm256_movemask_ps(outcome);
+    for (k=0; k<VECTOR_WIDTH; k++)
+        mask[k] = (bits >> k) & 1;
+}
+
+#else
+#define VECTOR_WIDTH 0
+#endif
+
+/**
+ * Moves n squirrels by the random numbers diff_x and diff_y as squirrelStepBy does, x and y are updated in place,
+ * and gives the land cell each squirrel moves into as getCellFromPosition does on a land of width x height cells
+ */
+void squirrelStepBlock(int n, float * x, float * y, const float * diff_x, const float * diff_y, int width, int height, int * cell) {
+    int i = 0, column, row;
+    float sx, sy;
+
+#if defined(__AVX512F__)
+    __m512 vwidth = _mm512_set1_ps((float) width), vheight = _mm512_set1_ps((float) height);
+    __m512i lastColumn = _mm512_set1_epi32(width - 1), lastRow = _mm512_set1_epi32(height - 1);
+    __m512i rowLength = _mm512_set1_epi32(width);
+    for (; i + VECTOR_WIDTH <= n; i += VECTOR_WIDTH) {
+        __m512 vx = _mm512_add_ps(_mm512_loadu_ps(&x[i]), _mm512_loadu_ps(&diff_x[i]));
+        __m512 vy = _mm512_add_ps(_mm512_loadu_ps(&y[i]), _mm512_loadu_ps(&diff_y[i]));
+        vx = _mm512_sub_ps(vx, _mm512_roundscale_ps(vx, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+        vy = _mm512_sub_ps(vy, _mm512_roundscale_ps(vy, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+        _mm512_storeu_ps(&x[i], vx);
+        _mm512_storeu_ps(&y[i], vy);
+        __m512i vcolumn = _mm512_min_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(vx, vwidth)), lastColumn);
+        __m512i vrow = _mm512_min_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(vy, vheight)), lastRow);
+        _mm512_storeu_si512(&cell[i], _mm512_add_epi32(vcolumn, _mm512_mullo_epi32(vrow, rowLength)));
+    }
+#elif defined(__AVX2__)
+    __m256 vwidth = _mm256_set1_ps((float) width), vheight = _mm256_set1_ps((float) height);
+    __m256i lastColumn = _mm256_set1_epi32(width - 1), lastRow = _mm256_set1_epi32(height - 1);
+    __m256i rowLength = _mm256_set1_epi32(width);
+    for (; i + VECTOR_WIDTH <= n; i += VECTOR_WIDTH) {
+        __m256 vx = _mm256_add_ps(_mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&diff_x[i]));
+        __m256 vy = _mm256_add_ps(_mm256_loadu_ps(&y[i]), _mm256_loadu_ps(&diff_y[i]));
+        vx = _mm256_sub_ps(vx, _mm256_round_ps(vx, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+        vy = _mm256_sub_ps(vy, _mm256_round_ps(vy, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+        _mm256_storeu_ps(&x[i], vx);
+        _mm256_storeu_ps(&y[i], vy);
+        __m256i vcolumn = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(vx, vwidth)), lastColumn);
+        __m256i vrow = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(vy, vheight)), lastRow);
+        _mm256_storeu_si256((__m256i *) &cell[i], _mm256_add_epi32(vcolumn, _mm256_mullo_epi32(vrow, rowLength)));
+    }
+#endif
+
+    for (; i<n; i++) {
+        sx = x[i] + diff_x[i];
+        sy = y[i] + diff_y[i];
+        x[i] = sx - (int) sx;
+        y[i] = sy - (int) sy;
+        column = (int) (x[i] * width);
+        row = (int) (y[i] * height);
+        cell[i] = (column < width ? column : width - 1) + width * (row < height ? row : height - 1);
+    }
+}
+
+/**
+ * Decides for n squirrels whether they give birth, mask[i] is 1 if the random number random[i] is below the
+ * probability willGiveBirth gives for the average population avg_pop[i]
+ */
+void willGiveBirthBlock(int n, const float * avg_pop, const float * random, unsigned char * mask) {
+    int i = 0;
+
+#if defined(__AVX512F__)
+    __m512 scale = _mm512_set1_ps(1.0f / BIRTH_PROBABILITY);
+    for (; i + VECTOR_WIDTH <= n; i += VECTOR_WIDTH) {
+        __m512 tmp = _mm512_mul_ps(_mm512_loadu_ps(&avg_pop[i]), scale);
+        __m512 probability = _mm512_div_ps(atanApproxVector(_mm512_mul_ps(tmp, tmp)),
+                                           _mm512_mul_ps(_mm512_set1_ps(4.0f), tmp));
+        storeMask(&mask[i], _mm512_cmp_ps_mask(_mm512_loadu_ps(&random[i]), probability, _CMP_LT_OQ));
+    }
+#elif defined(__AVX2__)
+    __m256 scale = _mm256_set1_ps(1.0f / BIRTH_PROBABILITY);
+    for (; i + VECTOR_WIDTH <= n; i += VECTOR_WIDTH) {
+        __m256 tmp = _mm256_mul_ps(_mm256_loadu_ps(&avg_pop[i]), scale);
+        __m256 probability = _mm256_div_ps(atanApproxVector(_mm256_mul_ps(tmp, tmp)),
+                                           _mm256_mul_ps(_mm256_set1_ps(4.0f), tmp));
+        storeMask(&mask[i], _mm256_cmp_ps(_mm256_loadu_ps(&random[i]), probability, _CMP_LT_OQ));
+    }
+#endif
+
+    for (; i<n; i++)
+        mask[i] = random[i] < birthProbability(avg_pop[i]);
+}
+
+/**
+ * Decides for n squirrels whether they catch disease, mask[i] is 1 if the random number random[i] is below the
+ * probability willCatchDisease gives for the average infection level avg_inf_level[i]
+ */
+void willCatchDiseaseBlock(int n, const float * avg_inf_level, const float * random, unsigned char * mask) {
+    int i = 0;
+
+#if defined(__AVX512F__)
+    __m512 scale = _mm512_set1_ps(1.0f / DISEASE_PROBABILITY);
+    for (; i + VECTOR_WIDTH <= n; i += VECTOR_WIDTH) {
+        __m512 level = _mm512_min_ps(_mm512_loadu_ps(&avg_inf_level[i]), _mm512_set1_ps(DISEASE_MAX_LEVEL));
+        __m512 probability = _mm512_mul_ps(atanApproxVector(_mm512_mul_ps(level, scale)), _mm512_set1_ps(1.0f / PI_F));
+        storeMask(&mask[i], _mm512_cmp_ps_mask(_mm512_loadu_ps(&random[i]), probability, _CMP_LT_OQ));
+    }
+#elif defined(__AVX2__)
+    __m256 scale = _mm256_set1_ps(1.0f / DISEASE_PROBABILITY);
+    for (; i + VECTOR_WIDTH <= n; i += VECTOR_WIDTH) {
+        __m256 level = _mm256_min_ps(_mm256_loadu_ps(&avg_inf_level[i]), _mm256_set1_ps(DISEASE_MAX_LEVEL));
+        __m256 probability = _mm256_mul_ps(atanApproxVector(_mm256_mul_ps(level, scale)), _mm256_set1_ps(1.0f / PI_F));
+        storeMask(&mask[i], _mm256_cmp_ps(_mm256_loadu_ps(&random[i]), probability, _CMP_LT_OQ));
+    }
+#endif
+
+    for (; i<n; i++)
+        mask[i] = random[i] < diseaseProbability(avg_inf_level[i]);
+}
+
+/**
+ * Decides for n squirrels whether they die, mask[i] is 1 if the random number random[i] is below the
+ * probability of willDie
+ */
+void willDieBlock(int n, const float * random, unsigned char * mask) {
+    int i;
+    // A plain comparison, the compiler vectorises it
+    for (i=0; i<n; i++)
+        mask[i] = random[i] < DIE_PROBABILITY;
+}
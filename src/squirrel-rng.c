@@ -0,0 +1,137 @@
+#include <stdint.h>
+
+#include "../include/squirrel-rng.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+#define PHILOX_LANES 8
+#define FLOAT_SCALE (1.0f / 16777216.0f)
+
+/**
+ * One Philox4x32-10 block, the four words of output are a function of the counter and the key only
+ */
+static void philoxBlock(const uint32_t counter[4], const uint32_t key[2], uint32_t output[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    uint64_t p0, p1;
+    int r;
+
+    for (r=0; r<PHILOX_ROUNDS; r++) {
+        p0 = (uint64_t) PHILOX_M0 * c0;
+        p1 = (uint64_t) PHILOX_M1 * c2;
+        c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t) p1;
+        c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t) p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    output[0] = c0;
+    output[1] = c1;
+    output[2] = c2;
+    output[3] = c3;
+}
+
+/**
+ * Sets the generator to the stream of the squirrel id under the global seed. There is no hidden state, so any
+ * number of generators can be used at once by one process or thread, and a squirrel draws the same numbers
+ * whichever process or thread steps it. Call seekSquirrelRNG before drawing.
+ */
+void seedSquirrelRNG(struct SquirrelRNG * rng, uint64_t seed, uint64_t id) {
+    rng->key[0] = (uint32_t) seed;
+    rng->key[1] = (uint32_t) (seed >> 32);
+    rng->counter[0] = 0;
+    rng->counter[1] = 0;
+    rng->counter[2] = (uint32_t) id;
+    rng->counter[3] = (uint32_t) (id >> 32);
+    rng->next = 4;
+}
+
+/**
+ * Moves the generator to the start of a stream (SQUIRREL_RNG_MOVE or SQUIRREL_RNG_LIFE) of a step of the squirrel
+ */
+void seekSquirrelRNG(struct SquirrelRNG * rng, uint32_t step, uint32_t stream) {
+    rng->counter[0] = stream << 16;
+    rng->counter[1] = step;
+    rng->next = 4;
+}
+
+/**
+ * Returns the next random number of the stream, uniform in [0, 1)
+ */
+float squirrelRandom(struct SquirrelRNG * rng) {
+    if (rng->next == 4) {
+        philoxBlock(rng->counter, rng->key, rng->output);
+        rng->counter[0]++;
+        rng->next = 0;
+    }
+    return (rng->output[rng->next++] >> 8) * FLOAT_SCALE;
+}
+
+/**
+ * Returns a random 64 bits id drawn from the stream, it is used as the id of a baby squirrel
+ */
+uint64_t squirrelRandomId(struct SquirrelRNG * rng) {
+    uint64_t id;
+    if (rng->next > 2) {
+        philoxBlock(rng->counter, rng->key, rng->output);
+        rng->counter[0]++;
+        rng->next = 0;
+    }
+    id = (uint64_t) rng->output[rng->next] | ((uint64_t) rng->output[rng->next + 1] << 32);
+    rng->next += 2;
+    return id;
+}
+
+/**
+ * Fills out with the first four random numbers of a stream of the step of n squirrels, out[k*n + i] is the k-th
+ * number squirrelRandom gives for the squirrel ids[i] after seekSquirrelRNG(steps[i], stream), so each of the four
+ * numbers is a plane of n floats. The squirrels are generated PHILOX_LANES at a time in structure of arrays form
+ * so that the compiler can vectorise the rounds.
+ */
+void fillSquirrelRandom(uint64_t seed, const uint64_t * ids, const int * steps, uint32_t stream, int n, float * out) {
+    uint32_t c0[PHILOX_LANES], c1[PHILOX_LANES], c2[PHILOX_LANES], c3[PHILOX_LANES];
+    uint32_t k0, k1, h0, h1;
+    uint64_t p0, p1;
+    int base, lanes, l, r;
+
+    for (base=0; base<n; base+=PHILOX_LANES) {
+        lanes = n - base < PHILOX_LANES ? n - base : PHILOX_LANES;
+        for (l=0; l<PHILOX_LANES; l++) {
+            // The lanes after the last squirrel are computed and dropped
+            uint64_t id = ids[base + (l < lanes ? l : 0)];
+            c0[l] = stream << 16;
+            c1[l] = (uint32_t) steps[base + (l < lanes ? l : 0)];
+            c2[l] = (uint32_t) id;
+            c3[l] = (uint32_t) (id >> 32);
+        }
+
+        k0 = (uint32_t) seed;
+        k1 = (uint32_t) (seed >> 32);
+        for (r=0; r<PHILOX_ROUNDS; r++) {
+            for (l=0; l<PHILOX_LANES; l++) {
+                p0 = (uint64_t) PHILOX_M0 * c0[l];
+                p1 = (uint64_t) PHILOX_M1 * c2[l];
+                h0 = (uint32_t) (p0 >> 32);
+                h1 = (uint32_t) (p1 >> 32);
+                c0[l] = h1 ^ c1[l] ^ k0;
+                c1[l] = (uint32_t) p1;
+                c2[l] = h0 ^ c3[l] ^ k1;
+                c3[l] = (uint32_t) p0;
+            }
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+
+        for (l=0; l<lanes; l++) {
+            out[base + l] = (c0[l] >> 8) * FLOAT_SCALE;
+            out[n + base + l] = (c1[l] >> 8) * FLOAT_SCALE;
+            out[2 * n + base + l] = (c2[l] >> 8) * FLOAT_SCALE;
+            out[3 * n + base + l] = (c3[l] >> 8) * FLOAT_SCALE;
+        }
+    }
+}
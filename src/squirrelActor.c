@@ -3,15 +3,23 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <mpi.h>
 #include "../include/squirrelActor.h"
 #include "../include/squirrel-functions.h"
+#include "../include/landWindow.h"
+#include "../include/landGrid.h"
+#include "../include/ring.h"
+#include "../include/trace.h"
+#include "../include/latency.h"
 #include "../include/framework.h"
 #include "../include/config.h"
 #include "../include/actorConfig.h"
 
-static long seed;
-int cellWorkers[LENGTH_OF_LAND];
+static struct SquirrelRNG rng;
+static int month;  // The month the squirrel is in, for the step-synchronous months
+uint64_t id;  // The id of the squirrel's random number stream
 int controllerWorkerPid;
 int rank;
 float x;
@@ -19,93 +27,99 @@ float y;
 int state;  // 0: does not exist; 1: healthy; 2: sick;
 int steps;  // The total number of steps
 int sickSteps; // The steps after being sick
-int pop[LAST_POPULATION_STEPS];  // Last 50 population level
-int inf[LAST_INFECTION_STEPS];  // Last 50 infection level
+int monthSteps; // The steps made in the current month, for the step-synchronous months
+int * pop;  // Last LAST_POPULATION_STEPS population level
+int * inf;  // Last LAST_INFECTION_STEPS infection level
+int popSum;  // The running sum of pop
+int infSum;  // The running sum of inf
 MPI_Status status;
 
 int count;
 int position;
+int landPid;    // The land actor owning the cell the squirrel is in
+int visit[2];   // The offset of the cell in the block of its land actor, and the state of the squirrel
 int recvBuffer[2];
 
 /** ========= The functions blow from actor framework, they will be called in framework.c ========= **/
-int squirrelAsk(int workerPid);
+void squirrelAsk(int index, struct ActorInit * init);
 int initialiseSquirrel();
 int squirrelWorker();
 /** ========= The functions blow belong to this actor ========= **/
 int squirlGo();
+int squirlUpdate();
+int waitNextMonth();
 void reproduce();
 float get_avg_inf_level();
 float get_avg_pop();
 
 /**
- * @brief The function for worker asking message from the master.
- * @param[in] workerPid
- * The workers' pids.
+ * @brief Fill the init record of an initial squirrel, the first INITIAL_INFECTION_LEVEL of them are sick.
+ * @param[in] index
+ * The place of the squirrel in the initial squirrels.
+ * @param[out] init
  *
  */
-int squirrelAsk(int workerPid){
-    int SquirlState;
-    if (sickCount < INITIAL_INFECTION_LEVEL){
-        SquirlState = SICK;
-        sickCount++;
-    } else {
-        SquirlState = HEALTHY;
-    }
-
-    MPI_Send(&SquirlState, 1, MPI_INT, workerPid, INITIAL_TAG, MPI_COMM_WORLD);
-    // Tell Squirrels who is controller
-    MPI_Send(&controllers[0], 1, MPI_INT, workerPid, INITIAL_TAG, MPI_COMM_WORLD);
-    // Tell Squirrels who are land actors
-    MPI_Send(cellWorkers, LENGTH_OF_LAND, MPI_INT, workerPid, INITIAL_TAG, MPI_COMM_WORLD);
-    return workerPid;
+void squirrelAsk(int index, struct ActorInit * init){
+    init->identity = SQUIRREL_ACTOR;
+    init->state = index < INITIAL_INFECTION_LEVEL ? SICK : HEALTHY;
+    init->month = 1;
+    // The initial squirrels are numbered, so their streams do not depend on the ranks they run on
+    init->id = (uint64_t) index;
 }
 
 /**
- * @brief The function for worker initialising after recv the message from the master.
+ * @brief The function for worker initialising from its own init record or the one of the parent squirrel.
+ * The squirrel may run on a process where a squirrel has died, it is started the same way.
  *
  */
 int initialiseSquirrel(){
     int i, parentId;
 
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-    seed = -1-rank;
-    initialiseRNG(&seed);
+    MPI_Comm_rank(simComm, &rank);
 
     x = 0;
     y = 0;
 
     parentId = getCommandData();
+    state = actorInit.state;
+    id = actorInit.id;
+    controllerWorkerPid = controllers[0];
 
-    MPI_Probe(parentId, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+    seedSquirrelRNG(&rng, SQUIRREL_RNG_SEED, id);
 
-    if (status.MPI_TAG == 10) {  // This means the process was a squirrel but dead. Now restart it.
-        // This is a redundant identity, will be covered
-        MPI_Recv(&state, 1, MPI_INT, parentId, IDENTITY_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    }
-
-    MPI_Recv(&state, 1, MPI_INT, parentId, INITIAL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    MPI_Recv(&controllerWorkerPid, 1, MPI_INT, parentId, INITIAL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    MPI_Recv(&cellWorkers, LENGTH_OF_LAND, MPI_INT, parentId, INITIAL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-    if (parentId == 0) {  // This means the squirrel is created by master, therefore, the x and y are randomised
-        squirrelStep(x, y, &x, &y, &seed);
+    if (parentId == 0) {  // This means the squirrel is an initial one, therefore, the x and y are randomised
+        seekSquirrelRNG(&rng, 0, SQUIRREL_RNG_PLACE);
+        squirrelStep(x, y, &x, &y, &rng);
     } else {  // This means the squirrel is birthed by a existed squirrel, therefore, inherit parent's x and y
-        float coord[2];
-        MPI_Recv(&coord, 2, MPI_FLOAT, parentId, INITIAL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        x = coord[0];
-        y = coord[1];
+        x = actorInit.coord[0];
+        y = actorInit.coord[1];
     }
 
+    // The baby makes the steps left in the parent's month, the initial squirrels start the month
+    monthSteps = actorInit.monthSteps;
+    month = actorInit.month;
+
     steps = 0;
     sickSteps = 0;
 
+    // The windows are sized by the parameters, which do not change while the process lives
+    if (pop == NULL) {
+        pop = (int *) malloc(sizeof(int) * LAST_POPULATION_STEPS);
+        inf = (int *) malloc(sizeof(int) * LAST_INFECTION_STEPS);
+        if (pop == NULL || inf == NULL) {
+            fprintf(stderr, "[Squirrel] Can not allocate the windows of the squirrel\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
     for (i=0; i<LAST_POPULATION_STEPS; i++)
         pop[i] = 0;
 
     for (i=0; i<LAST_INFECTION_STEPS; i++)
         inf[i] = 0;
 
+    popSum = 0;
+    infSum = 0;
     return 0;
 }
 
@@ -115,17 +129,20 @@ int initialiseSquirrel(){
  */
 int squirrelWorker(){
     while (state != NOT_EXIST && state != TERMINATE){
-        squirlGo();
+        if (STEP_SYNC_MONTHS && monthSteps == STEPS_PER_MONTH && !waitNextMonth())
+            state = TERMINATE;
+        else
+            squirlGo();
 
         if (state == NOT_EXIST){
             // Tell controller I am dead.
-            MPI_Send(&state, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, MPI_COMM_WORLD);
+            MPI_Send(&state, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, simComm);
         } else if (state == CATCH_DISEASE) {
             // Tell controller I am sick.
-            MPI_Send(&state, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, MPI_COMM_WORLD);
+            MPI_Send(&state, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, simComm);
             state = SICK;
         } else if (state == TERMINATE) {
-            MPI_Send(&state, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, MPI_COMM_WORLD);
+            MPI_Send(&state, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, simComm);
         }
     }
     return 0;
@@ -136,48 +153,110 @@ int squirrelWorker(){
  *
  */
 int squirlGo() {
-    squirrelStep(x, y, &x, &y, &seed);
+    int owner;
+    double wait, roundTrip;
+    seekSquirrelRNG(&rng, steps, SQUIRREL_RNG_MOVE);
+    squirrelStep(x, y, &x, &y, &rng);
     position = getCellFromPosition(x, y);
+    owner = getLandOwner(position);
+    landPid = cellWorkers[owner];
+    visit[0] = position - getLandFirstCell(owner);
+    visit[1] = state;
+
+    roundTrip = latencyBegin();
+    if (LAND_RMA_MODE) {
+        // Visit the cell in the land window, the visit is counted in the population and infection level
+        int visits = 1, sickVisits = state == SICK;
+        int visited = visitLandWindow(landPid, 1, &visit[0], &visits, &sickVisits, recvBuffer);
+        recordLatency(LATENCY_SQUIRL_GO, month, roundTrip);
+        if (!visited) {
+            state = TERMINATE;
+            return 0;
+        }
+        recvBuffer[0] += 1;
+        recvBuffer[1] += state == SICK;
+        return squirlUpdate();
+    }
 
-    // Send squirrel state to Land Actor
-    MPI_Send(&state, 1, MPI_INT, cellWorkers[position], LAND_RECV_TAG, MPI_COMM_WORLD);
+    // Send squirrel state to the Land Actor owning the cell
+    wait = traceBegin();
+    MPI_Send(visit, 2, MPI_INT, landPid, LAND_RECV_TAG, simComm);
 
     // Recv the population and infection level at this position
-    MPI_Probe(cellWorkers[position], SQUIRREL_RECV_TAG, MPI_COMM_WORLD, &status);
+    MPI_Probe(landPid, SQUIRREL_RECV_TAG, simComm, &status);
+    traceEnd(TRACE_LAND_REPLY, wait);
+    recordLatency(LATENCY_SQUIRL_GO, month, roundTrip);
     MPI_Get_count(&status, MPI_INT, &count);
 
     if (count == 0) {
         // Terminate signal, the squirrel should stop
-        MPI_Recv(NULL, 0, MPI_INT, cellWorkers[position], SQUIRREL_RECV_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(NULL, 0, MPI_INT, landPid, SQUIRREL_RECV_TAG, simComm, MPI_STATUS_IGNORE);
         state = TERMINATE;
         return 0;
     } else {
         // The squirrel can proceed
-        MPI_Recv(recvBuffer, 2, MPI_INT, cellWorkers[position], SQUIRREL_RECV_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(recvBuffer, 2, MPI_INT, landPid, SQUIRREL_RECV_TAG, simComm, MPI_STATUS_IGNORE);
+        return squirlUpdate();
+    }
+}
 
-        // Update population and infection level
-        pop[steps % LAST_POPULATION_STEPS] = recvBuffer[0];
-        inf[steps % LAST_INFECTION_STEPS] = recvBuffer[1];
+/**
+ * @brief The squirrel records the population and infection level of the cell it visited,
+ * then try to catch disease, reproduce and die.
+ *
+ */
+int squirlUpdate() {
+    int catchDisease, giveBirth, die;
+    seekSquirrelRNG(&rng, steps, SQUIRREL_RNG_LIFE);
 
-        steps++;
+    // Update population and infection level, the oldest values leave the running sums
+    popSum += recvBuffer[0] - pop[RING_SLOT(steps, LAST_POPULATION_STEPS)];
+    infSum += recvBuffer[1] - inf[RING_SLOT(steps, LAST_INFECTION_STEPS)];
+    pop[RING_SLOT(steps, LAST_POPULATION_STEPS)] = recvBuffer[0];
+    inf[RING_SLOT(steps, LAST_INFECTION_STEPS)] = recvBuffer[1];
 
-        if (state == SICK)
-            sickSteps++;
+    steps++;
+    monthSteps++;
 
-        // The squirrel will catches disease
-        if (steps > CATCH_DISEASE_STEPS && state == HEALTHY && willCatchDisease(get_avg_inf_level(), &seed))
-            state = CATCH_DISEASE;
+    if (state == SICK)
+        sickSteps++;
 
-        // The squirrel will give birth
-        if (steps % GIVE_BIRTH_STEPS == 0 && willGiveBirth(get_avg_pop(), &seed))
-            reproduce();
+    // The numbers of the step are drawn in the same order whatever the squirrel does, as the batched squirrels do
+    catchDisease = willCatchDisease(get_avg_inf_level(), &rng);
+    giveBirth = willGiveBirth(get_avg_pop(), &rng);
+    die = willDie(&rng);
 
-        // The squirrel will die
-        if (sickSteps > 50 && willDie(&seed))
-            state = NOT_EXIST;
+    // The squirrel will catches disease
+    if (steps > CATCH_DISEASE_STEPS && state == HEALTHY && catchDisease)
+        state = CATCH_DISEASE;
 
-        return 1;
-    }
+    // The squirrel will give birth
+    if (steps % GIVE_BIRTH_STEPS == 0 && giveBirth)
+        reproduce();
+
+    // The squirrel will die
+    if (sickSteps > 50 && die)
+        state = NOT_EXIST;
+
+    return 1;
+}
+
+/**
+ * @brief The squirrel has made all its steps of the month, it tells the controller
+ * and waits until the controller starts the next month
+ * @return 1 if the squirrel goes on to the next month, 0 if the simulation stops
+ *
+ */
+int waitNextMonth(){
+    int epochSignal[2], nextMonth;
+    epochSignal[0] = EPOCH_DONE;
+    epochSignal[1] = 1;
+    MPI_Send(epochSignal, 2, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, simComm);
+    MPI_Recv(&nextMonth, 1, MPI_INT, controllerWorkerPid, EPOCH_TAG, simComm, MPI_STATUS_IGNORE);
+
+    monthSteps = 0;
+    month = nextMonth + 1;
+    return nextMonth != SQUIRREL_STOP_SIGNAL;
 }
 
 /**
@@ -187,29 +266,36 @@ int squirlGo() {
  */
 void reproduce(){
     /* Create a new process and squirrel */
-    int childPid, childState, identity;
+    int childPid, childState;
+    double spawn, permission, placement;
+    struct ActorInit init = {0};
+    // The baby's stream id is drawn from the parent's stream, the parent's steps already count this step
+    seekSquirrelRNG(&rng, steps - 1, SQUIRREL_RNG_CHILD);
+    init.id = squirrelRandomId(&rng);
     childState = BORN;
     // Enquiry controller whether I can give birth
-    MPI_Send(&childState, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, MPI_COMM_WORLD);
-    MPI_Recv(&childState, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    permission = latencyBegin();
+    MPI_Send(&childState, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, simComm);
+    MPI_Recv(&childState, 1, MPI_INT, controllerWorkerPid, SQUIRREL_CONTROLLER_TAG, simComm, MPI_STATUS_IGNORE);
+    recordLatency(LATENCY_REPRODUCE, month, permission);
     // If it does not recv the BORN signal, it means the number of squirrels out of limit.
     if (childState == HEALTHY) {
+        spawn = traceBegin();
+        placement = latencyBegin();
         childPid = startWorkerProcess();
-        identity = SQUIRREL_ACTOR;
-
-        float coord[2];
-        coord[0] = x;
-        coord[1] = y;
-
-        MPI_Send(&identity, 1, MPI_INT, childPid, IDENTITY_TAG, MPI_COMM_WORLD);
-
-        MPI_Send(&childState, 1, MPI_INT, childPid, INITIAL_TAG, MPI_COMM_WORLD);
-        // Tell baby squirrel who is controller
-        MPI_Send(&controllerWorkerPid, 1, MPI_INT, childPid, INITIAL_TAG, MPI_COMM_WORLD);
-        // Tell baby squirrel who are land actors
-        MPI_Send(&cellWorkers, LENGTH_OF_LAND, MPI_INT, childPid, INITIAL_TAG, MPI_COMM_WORLD);
-
-        MPI_Send(coord, 2, MPI_FLOAT, childPid, INITIAL_TAG, MPI_COMM_WORLD);
+        traceEnd(TRACE_SPAWN, spawn);
+        recordLatency(LATENCY_START_WORKER, month, placement);
+
+        // The baby is born where the parent is, the controller and the land actors are known to every process
+        init.identity = SQUIRREL_ACTOR;
+        init.state = childState;
+        init.coord[0] = x;
+        init.coord[1] = y;
+        if (STEP_SYNC_MONTHS) {
+            init.monthSteps = monthSteps;
+            init.month = month;
+        }
+        sendActorInit(&init, childPid);
     }
 }
 
@@ -218,14 +304,7 @@ void reproduce(){
  *
  */
 float get_avg_inf_level(){
-    int i;
-    float avg_inf_level;
-    avg_inf_level = 0.0;
-    for (i = 0; i < LAST_INFECTION_STEPS; i++)
-        avg_inf_level += inf[i];
-
-    avg_inf_level /= LAST_INFECTION_STEPS;
-    return avg_inf_level;
+    return (float) infSum / LAST_INFECTION_STEPS;
 }
 
 /**
@@ -233,12 +312,5 @@ float get_avg_inf_level(){
  *
  */
 float get_avg_pop(){
-    int i;
-    float avg_pop;
-    avg_pop = 0.0;
-    for (i=0; i<LAST_POPULATION_STEPS; i++)
-        avg_pop += pop[i];
-
-    avg_pop /= LAST_POPULATION_STEPS;
-    return avg_pop;
+    return (float) popSum / LAST_POPULATION_STEPS;
 }
@@ -0,0 +1,720 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <mpi.h>
+#include "../include/squirrelBatchActor.h"
+#include "../include/squirrel-functions.h"
+#include "../include/squirrel-kernels.h"
+#include "../include/squirrel-block.h"
+#include "../include/landWindow.h"
+#include "../include/landGrid.h"
+#include "../include/checkpoint.h"
+#include "../include/trace.h"
+#include "../include/latency.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+#include "../include/actorConfig.h"
+
+static struct SquirrelRNG rng;  // Set to the stream of one squirrel at a time
+static struct SquirrelBlock block;
+static int controllerPid;
+static int terminated;
+static int monthTicks;  // The ticks made in the current month, for the step-synchronous months
+static int month;       // The month the block is in, for the step-synchronous months
+
+/** The counts kept for the controller, with the accounting reduction **/
+static MPI_Comm accountComm;
+static int accountCounts[ACCOUNT_SIZE];  // Since the last report to the controller
+static int epochCounts[ACCOUNT_SIZE];    // Of the reduction in flight
+
+/** The births the block can decide by itself, leased by the controller **/
+static int birthLease;
+static int leaseRequested;
+static int leaseSignal[ACCOUNT_SIZE + 1];
+static int leaseGrant;
+static MPI_Request leaseRequests[2];
+
+/** The buffers of one tick, the visits are grouped by land cell so each cell gets one message per tick **/
+static int tickCapacity;
+static int * position;      // The land cell of each squirrel
+static int * slot;          // Where the visit of each squirrel is in the visit buffer
+static int * landEnd;       // Where the visits of each land actor end, then begin, in the visit buffer
+static int * visitBuffer;   // (cell, state) pairs grouped by land actor, the cell is the offset in the actor's block
+static int * replyBuffer;   // (population, infection) pairs in the same order as the visit buffer
+static float * moveRandom;  // The numbers of the SQUIRREL_RNG_MOVE stream, 4 planes of one number per squirrel of a chunk
+static float * lifeRandom;  // The numbers of the SQUIRREL_RNG_LIFE stream, 4 planes of one number per squirrel of a chunk
+static float * avgPop;      // The average population influx of each squirrel after its visit
+static float * avgInf;      // The average infection level of each squirrel after its visit
+static unsigned char * catchMask;  // The outcomes of the decisions of each squirrel
+static unsigned char * birthMask;
+static unsigned char * dieMask;
+static MPI_Request * requestList;
+static MPI_Status * statusList;
+/** The visits of the land window, grouped by cell **/
+static int * cellOrder;     // The slots of the visits to one land actor, sorted by cell
+static int * cellOffsets;   // The cells visited, and the visits and sick visits of each one
+static int * cellVisits;
+static int * cellSickVisits;
+static int * cellPopNInf;   // The (population, infection) pair of each cell before the visits
+
+/** ========= The functions blow from actor framework, they will be called in framework.c ========= **/
+void squirrelBatchAsk(int index, struct ActorInit * init);
+int initialiseSquirrelBatch();
+int squirrelBatchWorker();
+/** ========= The functions blow belong to this actor ========= **/
+static void addSquirrel(uint64_t id, float x, float y, int state);
+static void reserveTickBuffers(int n);
+static void freeTickBuffers();
+static void moveBlock(int n);
+static void moveChunk(int begin, int count);
+static void visitLands(int n);
+static void visitLandWindows(int n, int * landBegin);
+static int compareVisitCells(const void * a, const void * b);
+static void decideBlock(int n);
+static void decideChunk(int begin, int count);
+static void squirlGoInBlock(int i);
+static int waitNextMonth();
+static void reproduceInBlock(int parent);
+static int useBirthLease();
+static void requestLease();
+static void receiveLease(int wait);
+
+/**
+ * @brief Fill the init record of an initial batched squirrel actor.
+ * The initial squirrels are split evenly over the batched squirrel actors,
+ * and the first INITIAL_INFECTION_LEVEL of them are sick. The initial squirrels are numbered, and each block
+ * gets the id of its first squirrel. On a restart the squirrels of the checkpoint are split evenly instead, and
+ * each block gets the place of its first squirrel in the checkpoint.
+ * @param[in] index
+ * The place of the block in the batched squirrel actors.
+ * @param[out] init
+ *
+ */
+void squirrelBatchAsk(int index, struct ActorInit * init){
+    long first, last, total;
+    int * blockInfo = init->block;
+    int64_t header[CHECKPOINT_HEADER_FIELDS];
+
+    total = INITIAL_NUMBER_OF_SQUIRRELS;
+    init->month = 1;
+    if (RESTART_FILE[0] != '\0') {
+        readCheckpointHeader(RESTART_FILE, header);
+        total = (long) header[CHECKPOINT_SQUIRRELS];
+        init->month = (int) header[CHECKPOINT_MONTH] + 1;
+    }
+    first = (long) index * total / SQUIRREL_BATCH_ACTORS;
+    last = (long) (index + 1) * total / SQUIRREL_BATCH_ACTORS;
+
+    blockInfo[0] = (int) (last - first);  // The number of squirrels in this block
+    blockInfo[1] = 0;                     // The number of sick squirrels in this block, the checkpoint keeps them
+    if (RESTART_FILE[0] == '\0' && first < INITIAL_INFECTION_LEVEL)
+        blockInfo[1] = (int) ((last < INITIAL_INFECTION_LEVEL ? last : INITIAL_INFECTION_LEVEL) - first);
+    blockInfo[2] = (int) first;           // The id of the first squirrel in this block, or its place in the checkpoint
+
+    // The block knows the controller, the land actors and the other blocks from the pids every process works out
+    init->identity = SQUIRREL_BATCH_ACTOR;
+}
+
+/**
+ * @brief The function for worker initialising after recv the message from the master.
+ *
+ */
+int initialiseSquirrelBatch(){
+    int i, * blockInfo = actorInit.block;
+    uint64_t id;
+    float x, y;
+
+    // The land actors are a parameter, which does not change while the process lives
+    if (landEnd == NULL) {
+        landEnd = (int *) malloc(sizeof(int) * LAND_ACTORS);
+        if (landEnd == NULL) {
+            fprintf(stderr, "[SquirrelBatch] Can not allocate the visit ends of %d lands\n", LAND_ACTORS);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    controllerPid = controllers[0];
+    // The communicator of the accounting reduction is split at startup
+    accountComm = actorComm;
+
+    freeSquirrelBlock(&block);
+    if (reserveSquirrelBlock(&block, blockInfo[0])) {
+        fprintf(stderr, "[SquirrelBatch] Can not allocate a block of %d squirrels\n", blockInfo[0]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // On a restart the squirrels go on from the checkpoint
+    if (RESTART_FILE[0] != '\0')
+        readCheckpointSquirrels(RESTART_FILE, blockInfo[2], blockInfo[0], &block);
+    for (i=0; i<blockInfo[0] && RESTART_FILE[0] == '\0'; i++) {
+        // The squirrels are created by master, therefore, the x and y are randomised
+        id = (uint64_t) blockInfo[2] + i;
+        seedSquirrelRNG(&rng, SQUIRREL_RNG_SEED, id);
+        seekSquirrelRNG(&rng, 0, SQUIRREL_RNG_PLACE);
+        squirrelStep(0, 0, &x, &y, &rng);
+        addSquirrel(id, x, y, i < blockInfo[1] ? SICK : HEALTHY);
+    }
+
+    terminated = 0;
+    monthTicks = 0;
+    month = actorInit.month;
+    for (i=0; i<ACCOUNT_SIZE; i++)
+        accountCounts[i] = 0;
+
+    birthLease = 0;
+    leaseRequested = 0;
+    if (BIRTH_LEASE_SIZE)
+        requestLease();
+    return 0;
+}
+
+/**
+ * @brief The actor work code. Every tick steps all the squirrels in the block once,
+ * then the dead squirrels are removed from the block.
+ *
+ */
+int squirrelBatchWorker(){
+    int i, n, signal[2];
+
+    // With the accounting reduction every block takes part in the reduction of every month, an empty block as well
+    while ((block.count > 0 || ACCOUNTING_REDUCE_MODE) && !terminated) {
+        if (block.count == 0)
+            monthTicks = STEPS_PER_MONTH;
+        if (STEP_SYNC_MONTHS && monthTicks == STEPS_PER_MONTH && !waitNextMonth()) {
+            terminated = 1;
+            break;
+        }
+
+        // The babies born in this tick start to move from the next tick
+        n = block.count;
+        reserveTickBuffers(n);
+        moveBlock(n);
+        visitLands(n);
+        if (terminated)
+            break;
+
+        if (BIRTH_LEASE_SIZE)
+            receiveLease(0);
+        decideBlock(n);
+        for (i=0; i<n; i++)
+            squirlGoInBlock(i);
+
+        removeDeadSquirrelsFromBlock(&block);
+        monthTicks++;
+    }
+
+    if (terminated && block.count > 0) {
+        // Tell controller all the squirrels left in the block are terminated with one message
+        signal[0] = TERMINATE;
+        signal[1] = block.count;
+        MPI_Send(signal, 2, MPI_INT, controllerPid, SQUIRREL_CONTROLLER_TAG, simComm);
+    }
+
+    freeSquirrelBlock(&block);
+    freeTickBuffers();
+    return 0;
+}
+
+/**
+ * @brief Append a new squirrel to the end of the block
+ * @param[in] id
+ * The id of the new squirrel's random number stream
+ * @param[in] x
+ * @param[in] y
+ * The position of the new squirrel
+ * @param[in] state
+ * The state of the new squirrel
+ *
+ */
+static void addSquirrel(uint64_t id, float x, float y, int state){
+    if (addSquirrelToBlock(&block, id, x, y, state) < 0) {
+        fprintf(stderr, "[SquirrelBatch] Can not grow the block of %d squirrels\n", block.count);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+/**
+ * @brief Grow the buffers of a tick so that they can hold the visits of n squirrels
+ * @param[in] n
+ * The number of squirrels moving in this tick
+ *
+ */
+static void reserveTickBuffers(int n){
+    int requests;
+    if (n <= tickCapacity)
+        return;
+
+    tickCapacity = n > tickCapacity * 2 ? n : tickCapacity * 2;
+    // A message carries at most LAND_BATCH_VISITS visits, so the messages of a tick are at most the full ones and
+    // one partial message per land, each one a send and a receive
+    requests = 2 * (LAND_ACTORS + tickCapacity / LAND_BATCH_VISITS + 1);
+
+    position = (int *) realloc(position, sizeof(int) * tickCapacity);
+    slot = (int *) realloc(slot, sizeof(int) * tickCapacity);
+    visitBuffer = (int *) realloc(visitBuffer, sizeof(int) * tickCapacity * 2);
+    replyBuffer = (int *) realloc(replyBuffer, sizeof(int) * tickCapacity * 2);
+    moveRandom = (float *) realloc(moveRandom, sizeof(float) * tickCapacity * 4);
+    lifeRandom = (float *) realloc(lifeRandom, sizeof(float) * tickCapacity * 4);
+    avgPop = (float *) realloc(avgPop, sizeof(float) * tickCapacity);
+    avgInf = (float *) realloc(avgInf, sizeof(float) * tickCapacity);
+    catchMask = (unsigned char *) realloc(catchMask, tickCapacity);
+    birthMask = (unsigned char *) realloc(birthMask, tickCapacity);
+    dieMask = (unsigned char *) realloc(dieMask, tickCapacity);
+    requestList = (MPI_Request *) realloc(requestList, sizeof(MPI_Request) * requests);
+    statusList = (MPI_Status *) realloc(statusList, sizeof(MPI_Status) * requests);
+    if (LAND_RMA_MODE) {
+        cellOrder = (int *) realloc(cellOrder, sizeof(int) * tickCapacity);
+        cellOffsets = (int *) realloc(cellOffsets, sizeof(int) * tickCapacity);
+        cellVisits = (int *) realloc(cellVisits, sizeof(int) * tickCapacity);
+        cellSickVisits = (int *) realloc(cellSickVisits, sizeof(int) * tickCapacity);
+        cellPopNInf = (int *) realloc(cellPopNInf, sizeof(int) * tickCapacity * 2);
+    }
+
+    if (position == NULL || slot == NULL || visitBuffer == NULL || replyBuffer == NULL || moveRandom == NULL ||
+        lifeRandom == NULL || avgPop == NULL || avgInf == NULL || catchMask == NULL || birthMask == NULL ||
+        dieMask == NULL || requestList == NULL || statusList == NULL || (LAND_RMA_MODE && (cellOrder == NULL ||
+        cellOffsets == NULL || cellVisits == NULL || cellSickVisits == NULL || cellPopNInf == NULL))) {
+        fprintf(stderr, "[SquirrelBatch] Can not allocate the tick buffers of %d squirrels\n", n);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+/**
+ * @brief Release the buffers of a tick
+ *
+ */
+static void freeTickBuffers(){
+    free(position);
+    free(slot);
+    free(visitBuffer);
+    free(replyBuffer);
+    free(moveRandom);
+    free(lifeRandom);
+    free(avgPop);
+    free(avgInf);
+    free(catchMask);
+    free(birthMask);
+    free(dieMask);
+    free(requestList);
+    free(statusList);
+    free(cellOrder);
+    free(cellOffsets);
+    free(cellVisits);
+    free(cellSickVisits);
+    free(cellPopNInf);
+    position = slot = visitBuffer = replyBuffer = NULL;
+    moveRandom = lifeRandom = avgPop = avgInf = NULL;
+    catchMask = birthMask = dieMask = NULL;
+    requestList = NULL;
+    statusList = NULL;
+    cellOrder = cellOffsets = cellVisits = cellSickVisits = cellPopNInf = NULL;
+    tickCapacity = 0;
+}
+
+/**
+ * @brief The first n squirrels of the block move, and find the land cell they move into.
+ * The block is cut in chunks of SQUIRREL_THREAD_CHUNK squirrels that the SQUIRREL_THREADS threads move at the same
+ * time, the numbers of the moves of a chunk are drawn in bulk and the chunk moves with one kernel call.
+ * @param[in] n
+ * The number of squirrels moving in this tick
+ *
+ */
+static void moveBlock(int n){
+    int begin;
+
+    #pragma omp parallel for schedule(static) num_threads(SQUIRREL_THREADS) if(n > SQUIRREL_THREAD_CHUNK)
+    for (begin=0; begin<n; begin+=SQUIRREL_THREAD_CHUNK)
+        moveChunk(begin, n - begin < SQUIRREL_THREAD_CHUNK ? n - begin : SQUIRREL_THREAD_CHUNK);
+}
+
+/**
+ * @brief The squirrels begin to begin + count - 1 of the block move. The chunk keeps the four planes of its numbers
+ * in its own part of the buffer, so the chunks do not share anything.
+ * @param[in] begin
+ * @param[in] count
+ *
+ */
+static void moveChunk(int begin, int count){
+    float * random = &moveRandom[begin * 4];
+
+    fillSquirrelRandom(SQUIRREL_RNG_SEED, &block.id[begin], &block.steps[begin], SQUIRREL_RNG_MOVE, count, random);
+    squirrelStepBlock(count, &block.x[begin], &block.y[begin], random, &random[count], LAND_WIDTH, LAND_HEIGHT,
+                      &position[begin]);
+}
+
+/**
+ * @brief The squirrels of this tick visit their land cells. The visits are grouped by the land actor owning the
+ * cell, and every land gets one message of (cell, state) pairs (split in LAND_BATCH_VISITS visits at most) and
+ * replies with one message of (population, infection) pairs in the same order. If any land replies with an empty
+ * message, the simulation is stopping and the block is terminated.
+ * @param[in] n
+ * The number of squirrels moving in this tick
+ *
+ */
+static void visitLands(int n){
+    int i, land, begin, end, visits, count, requestCount;
+    double wait, roundTrip;
+
+    // Count the visits of each land, then give each squirrel its slot so the visits are grouped by land
+    for (land=0; land<LAND_ACTORS; land++)
+        landEnd[land] = 0;
+    for (i=0; i<n; i++) {
+        // The cell becomes the offset of the cell in the block of the land actor owning it
+        slot[i] = getLandOwner(position[i]);
+        position[i] -= getLandFirstCell(slot[i]);
+        landEnd[slot[i]]++;
+    }
+    for (land=1; land<LAND_ACTORS; land++)
+        landEnd[land] += landEnd[land - 1];
+    for (i=n-1; i>=0; i--) {
+        slot[i] = --landEnd[slot[i]];
+        visitBuffer[slot[i] * 2] = position[i];
+        visitBuffer[slot[i] * 2 + 1] = block.state[i];
+    }
+
+    // landEnd now holds the first slot of each land
+    roundTrip = latencyBegin();
+    if (LAND_RMA_MODE) {
+        visitLandWindows(n, landEnd);
+        recordLatency(LATENCY_SQUIRL_GO, month, roundTrip);
+        return;
+    }
+
+    wait = traceBegin();
+    requestCount = 0;
+    for (land=0; land<LAND_ACTORS; land++) {
+        end = land + 1 < LAND_ACTORS ? landEnd[land + 1] : n;
+        for (begin=landEnd[land]; begin<end; begin+=visits) {
+            visits = end - begin < LAND_BATCH_VISITS ? end - begin : LAND_BATCH_VISITS;
+            MPI_Irecv(&replyBuffer[begin * 2], visits * 2, MPI_INT, cellWorkers[land], SQUIRREL_RECV_TAG,
+                      simComm, &requestList[requestCount++]);
+            MPI_Isend(&visitBuffer[begin * 2], visits * 2, MPI_INT, cellWorkers[land], LAND_RECV_TAG,
+                      simComm, &requestList[requestCount++]);
+        }
+    }
+
+    MPI_Waitall(requestCount, requestList, statusList);
+    traceEnd(TRACE_LAND_REPLY, wait);
+    recordLatency(LATENCY_SQUIRL_GO, month, roundTrip);
+
+    // The receives are at the even places of the request list
+    for (i=0; i<requestCount; i+=2) {
+        MPI_Get_count(&statusList[i], MPI_INT, &count);
+        if (count == 0)
+            // Terminate signal, all the squirrels in the block should stop
+            terminated = 1;
+    }
+}
+
+/**
+ * @brief The squirrels of this tick visit their land cells in the land window. Every land gets the updates of all
+ * its visited cells under one lock, one atomic update per cell for all its visits, and the population and
+ * infection level each squirrel gets are the running sums as if the visits came one by one in order, the same
+ * as updateLand in landActor.c replies.
+ * @param[in] n
+ * The number of squirrels moving in this tick
+ * @param[in] landBegin
+ * The first slot of each land in the visit buffer
+ *
+ */
+static void visitLandWindows(int n, int * landBegin){
+    int i, k, c, land, end, cells, popNInf[2];
+
+    for (land=0; land<LAND_ACTORS; land++) {
+        end = land + 1 < LAND_ACTORS ? landBegin[land + 1] : n;
+        if (end == landBegin[land])
+            continue;
+
+        // Sort the visits by cell, the visits of one cell stay in the order of the squirrels
+        for (i=landBegin[land]; i<end; i++)
+            cellOrder[i - landBegin[land]] = i;
+        qsort(cellOrder, end - landBegin[land], sizeof(int), compareVisitCells);
+
+        cells = 0;
+        for (k=0; k<end-landBegin[land]; k++) {
+            i = cellOrder[k];
+            if (cells == 0 || cellOffsets[cells - 1] != visitBuffer[i * 2]) {
+                cellOffsets[cells] = visitBuffer[i * 2];
+                cellVisits[cells] = 0;
+                cellSickVisits[cells] = 0;
+                cells++;
+            }
+            cellVisits[cells - 1]++;
+            cellSickVisits[cells - 1] += visitBuffer[i * 2 + 1] == SICK;
+        }
+
+        if (!visitLandWindow(cellWorkers[land], cells, cellOffsets, cellVisits, cellSickVisits, cellPopNInf)) {
+            // The stop flag is set, all the squirrels in the block should stop
+            terminated = 1;
+            return;
+        }
+
+        c = -1;
+        for (k=0; k<end-landBegin[land]; k++) {
+            i = cellOrder[k];
+            if (c < 0 || cellOffsets[c] != visitBuffer[i * 2]) {
+                c++;
+                popNInf[0] = cellPopNInf[c * 2];
+                popNInf[1] = cellPopNInf[c * 2 + 1];
+            }
+            popNInf[0]++;
+            if (visitBuffer[i * 2 + 1] == SICK)
+                popNInf[1]++;
+            replyBuffer[i * 2] = popNInf[0];
+            replyBuffer[i * 2 + 1] = popNInf[1];
+        }
+    }
+}
+
+/**
+ * @brief Order two slots of the visit buffer by the cell visited, then by the slot
+ *
+ */
+static int compareVisitCells(const void * a, const void * b){
+    int slotA = *(const int *) a, slotB = *(const int *) b;
+    if (visitBuffer[slotA * 2] != visitBuffer[slotB * 2])
+        return visitBuffer[slotA * 2] < visitBuffer[slotB * 2] ? -1 : 1;
+    return slotA < slotB ? -1 : (slotA > slotB);
+}
+
+/**
+ * @brief The first n squirrels of the block record the population and infection level their lands replied,
+ * then the decisions whether they catch disease, give birth and die are made for a chunk at once. The chunks are
+ * shared out over the SQUIRREL_THREADS threads as in moveBlock.
+ * @param[in] n
+ * The number of squirrels moving in this tick
+ *
+ */
+static void decideBlock(int n){
+    int begin;
+
+    #pragma omp parallel for schedule(static) num_threads(SQUIRREL_THREADS) if(n > SQUIRREL_THREAD_CHUNK)
+    for (begin=0; begin<n; begin+=SQUIRREL_THREAD_CHUNK)
+        decideChunk(begin, n - begin < SQUIRREL_THREAD_CHUNK ? n - begin : SQUIRREL_THREAD_CHUNK);
+}
+
+/**
+ * @brief The squirrels begin to begin + count - 1 of the block record their visits and decide what they do
+ * @param[in] begin
+ * @param[in] count
+ *
+ */
+static void decideChunk(int begin, int count){
+    int i, * recvBuffer;
+    float * random = &lifeRandom[begin * 4];
+
+    // The numbers of the step are drawn before the steps are counted
+    fillSquirrelRandom(SQUIRREL_RNG_SEED, &block.id[begin], &block.steps[begin], SQUIRREL_RNG_LIFE, count, random);
+
+    for (i=begin; i<begin + count; i++) {
+        recvBuffer = &replyBuffer[slot[i] * 2];
+
+        // Update population and infection level
+        recordBlockVisit(&block, i, recvBuffer[0], recvBuffer[1]);
+
+        block.steps[i]++;
+
+        if (block.state[i] == SICK)
+            block.sickSteps[i]++;
+
+        avgPop[i] = getBlockAvgPop(&block, i);
+        avgInf[i] = getBlockAvgInfLevel(&block, i);
+    }
+
+    willCatchDiseaseBlock(count, &avgInf[begin], &random[SQUIRREL_RNG_CATCH_DRAW * count], &catchMask[begin]);
+    willGiveBirthBlock(count, &avgPop[begin], &random[SQUIRREL_RNG_BIRTH_DRAW * count], &birthMask[begin]);
+    willDieBlock(count, &random[SQUIRREL_RNG_DIE_DRAW * count], &dieMask[begin]);
+}
+
+/**
+ * @brief The squirrel i of the block catches disease, reproduces and dies as decideBlock decided.
+ * This is the same as squirlGo in squirrelActor.c but on the block.
+ * @param[in] i
+ * The index of the squirrel in the block
+ *
+ */
+static void squirlGoInBlock(int i){
+    // The squirrel will catches disease
+    if (block.steps[i] > CATCH_DISEASE_STEPS && block.state[i] == HEALTHY && catchMask[i])
+        block.state[i] = CATCH_DISEASE;
+
+    // The squirrel will give birth
+    if (block.steps[i] % GIVE_BIRTH_STEPS == 0 && birthMask[i])
+        reproduceInBlock(i);
+
+    // The squirrel will die
+    if (block.sickSteps[i] > 50 && dieMask[i])
+        block.state[i] = NOT_EXIST;
+
+    if (block.state[i] == NOT_EXIST) {
+        // Tell controller the squirrel is dead, it will be removed from the block at the end of this tick
+        if (ACCOUNTING_REDUCE_MODE)
+            accountCounts[ACCOUNT_DIED]++;
+        else
+            MPI_Send(&block.state[i], 1, MPI_INT, controllerPid, SQUIRREL_CONTROLLER_TAG, simComm);
+    } else if (block.state[i] == CATCH_DISEASE) {
+        // Tell controller the squirrel is sick.
+        if (ACCOUNTING_REDUCE_MODE)
+            accountCounts[ACCOUNT_CAUGHT]++;
+        else
+            MPI_Send(&block.state[i], 1, MPI_INT, controllerPid, SQUIRREL_CONTROLLER_TAG, simComm);
+        block.state[i] = SICK;
+    }
+}
+
+/**
+ * @brief All the squirrels of the block have made their steps of the month, the block tells
+ * the controller and waits until the controller starts the next month. With the accounting reduction the
+ * block adds the counts it kept to the reduction of the month instead, and waits on the broadcast of the
+ * next month.
+ * @return 1 if the block goes on to the next month, 0 if the simulation stops
+ *
+ */
+static int waitNextMonth(){
+    int i, epochSignal[2], nextMonth;
+    MPI_Request accountRequest;
+
+    if (ACCOUNTING_REDUCE_MODE) {
+        // The controller has to count the lease request before the month is done, and the births left of the
+        // lease go back with the counts so the other blocks can have them next month
+        if (BIRTH_LEASE_SIZE) {
+            receiveLease(1);
+            accountCounts[ACCOUNT_RETURNED] += birthLease;
+            birthLease = 0;
+        }
+        for (i=0; i<ACCOUNT_SIZE; i++) {
+            epochCounts[i] = accountCounts[i];
+            accountCounts[i] = 0;
+        }
+        MPI_Ireduce(epochCounts, NULL, ACCOUNT_SIZE, MPI_INT, MPI_SUM, 0, accountComm, &accountRequest);
+        MPI_Bcast(&nextMonth, 1, MPI_INT, 0, accountComm);
+        MPI_Wait(&accountRequest, MPI_STATUS_IGNORE);
+        // The controller can have the blocks write a checkpoint before it lets them go on
+        while (nextMonth == CHECKPOINT_SIGNAL) {
+            writeCheckpoint(0, NULL, 0, 0, NULL, NULL, &block);
+            MPI_Bcast(&nextMonth, 1, MPI_INT, 0, accountComm);
+        }
+
+        if (BIRTH_LEASE_SIZE && nextMonth != SQUIRREL_STOP_SIGNAL)
+            requestLease();
+        monthTicks = 0;
+        month = nextMonth + 1;
+        return nextMonth != SQUIRREL_STOP_SIGNAL;
+    }
+
+    epochSignal[0] = EPOCH_DONE;
+    epochSignal[1] = block.count;
+    MPI_Send(epochSignal, 2, MPI_INT, controllerPid, SQUIRREL_CONTROLLER_TAG, simComm);
+    MPI_Recv(&nextMonth, 1, MPI_INT, controllerPid, EPOCH_TAG, simComm, MPI_STATUS_IGNORE);
+
+    monthTicks = 0;
+    month = nextMonth + 1;
+    return nextMonth != SQUIRREL_STOP_SIGNAL;
+}
+
+/**
+ * @brief The squirrel reproduce need to enquiry the controller, if the
+ * controller permit then the baby is added to the block at the parent's position
+ * @param[in] parent
+ * The index of the parent squirrel in the block
+ *
+ */
+static void reproduceInBlock(int parent){
+    int i, childState, birthSignal[ACCOUNT_SIZE + 1];
+    double permission;
+    uint64_t childId;
+    // The baby's stream id is drawn from the parent's stream, the parent's steps already count this step
+    seedSquirrelRNG(&rng, SQUIRREL_RNG_SEED, block.id[parent]);
+    seekSquirrelRNG(&rng, block.steps[parent] - 1, SQUIRREL_RNG_CHILD);
+    childId = squirrelRandomId(&rng);
+    if (BIRTH_LEASE_SIZE) {
+        // The block decides by itself while it has births leased
+        if (useBirthLease())
+            addSquirrel(childId, block.x[parent], block.y[parent], HEALTHY);
+        return;
+    }
+    // Enquiry controller whether I can give birth, with the counts kept so far so that it knows how many squirrels are alive
+    birthSignal[0] = BORN;
+    for (i=0; i<ACCOUNT_SIZE; i++) {
+        birthSignal[i + 1] = accountCounts[i];
+        accountCounts[i] = 0;
+    }
+    permission = latencyBegin();
+    MPI_Send(birthSignal, ACCOUNTING_REDUCE_MODE ? ACCOUNT_SIZE + 1 : 1, MPI_INT, controllerPid, SQUIRREL_CONTROLLER_TAG, simComm);
+    MPI_Recv(&childState, 1, MPI_INT, controllerPid, SQUIRREL_CONTROLLER_TAG, simComm, MPI_STATUS_IGNORE);
+    recordLatency(LATENCY_REPRODUCE, month, permission);
+    // If it does not recv the BORN signal, it means the number of squirrels out of limit.
+    if (childState == HEALTHY)
+        addSquirrel(childId, block.x[parent], block.y[parent], childState);
+}
+
+/**
+ * @brief Take one birth from the lease. The block asks the controller for more births when half of the lease
+ * is used, and only waits for them if the lease runs out before they come.
+ * @return 1 if the baby can be born, 0 if there is no room for it under MAX_SQUIRREL_NUMBER
+ *
+ */
+static int useBirthLease(){
+    double permission;
+    if (birthLease == 0) {
+        // The birth waits for the controller only when the lease has run out
+        if (!leaseRequested)
+            requestLease();
+        permission = latencyBegin();
+        receiveLease(1);
+        recordLatency(LATENCY_REPRODUCE, month, permission);
+        if (birthLease == 0)
+            return 0;
+    }
+
+    birthLease--;
+    accountCounts[ACCOUNT_BORN]++;
+    if (birthLease <= BIRTH_LEASE_SIZE / 2 && !leaseRequested)
+        requestLease();
+    return 1;
+}
+
+/**
+ * @brief Ask the controller for more births without waiting, the request carries the counts kept so far
+ *
+ */
+static void requestLease(){
+    int i;
+    leaseSignal[0] = LEASE;
+    for (i=0; i<ACCOUNT_SIZE; i++) {
+        leaseSignal[i + 1] = accountCounts[i];
+        accountCounts[i] = 0;
+    }
+
+    MPI_Irecv(&leaseGrant, 1, MPI_INT, controllerPid, LEASE_TAG, simComm, &leaseRequests[1]);
+    MPI_Isend(leaseSignal, ACCOUNT_SIZE + 1, MPI_INT, controllerPid, SQUIRREL_CONTROLLER_TAG, simComm,
+              &leaseRequests[0]);
+    leaseRequested = 1;
+}
+
+/**
+ * @brief Add the births the controller granted to the lease, if the request is answered
+ * @param[in] wait
+ * Wait for the answer if it is 1
+ *
+ */
+static void receiveLease(int wait){
+    int flag;
+    if (!leaseRequested)
+        return;
+
+    if (wait) {
+        MPI_Waitall(2, leaseRequests, MPI_STATUSES_IGNORE);
+    } else {
+        MPI_Testall(2, leaseRequests, &flag, MPI_STATUSES_IGNORE);
+        if (!flag)
+            return;
+    }
+
+    birthLease += leaseGrant;
+    leaseRequested = 0;
+}
@@ -0,0 +1,328 @@
+//
+// Created by Ray on 2020/4/7.
+//
+/*
+ * The shared-memory engine. It runs the whole simulation in one process with OpenMP threads and without MPI.
+ * The land cells are shared arrays updated with atomics, and the squirrels live in one structure of arrays
+ * block whose squirrels are partitioned across the threads on every step.
+ * To compile use `make omp`, and run it with `OMP_NUM_THREADS=n bin/run-omp [-c file] [NAME=value ...]`
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+#include "../include/squirrel-functions.h"
+#include "../include/squirrel-block.h"
+#include "../include/monthLog.h"
+#include "../include/config.h"
+#include "../include/actorConfig.h"
+#include "../include/ring.h"
+
+/** The land cells, the months of cell i start at i * LAST_POPULATION_MONTHS and i * LAST_INFECTION_MONTHS **/
+static int * population;
+static int * infection;
+static int * populationSum;
+static int * infectionSum;
+static int * popNInf;
+
+/** The squirrels, and the babies born on each thread during a step **/
+static struct SquirrelBlock squirrels;
+static struct SquirrelBlock * births;
+static int threads;
+
+/** The controller counters **/
+static int month;
+static int remainSquirrel;
+static int infectedSquirrel;
+static int totalDeadSquirrel;
+
+static void initialiseLand();
+static void initialiseSquirrels();
+static void stepAll();
+static int squirlGoShared(int i, struct SquirrelBlock * babies);
+static void visitLand(int position, int state, int * recvBuffer);
+static void reproduceShared(int parent, struct SquirrelRNG * rng, struct SquirrelBlock * babies);
+static void renewMonth();
+static void growError(struct SquirrelBlock * block);
+
+int main(int argc, char* argv[]) {
+    int steps, t;
+    double start, end;
+
+    if (readSimConfig(argc, argv)) {
+        fprintf(stderr, "Usage: %s [-c file] [NAME=value ...], the names are the parameters in config.h\n", argv[0]);
+        return 1;
+    }
+
+    threads = omp_get_max_threads();
+    births = (struct SquirrelBlock *) calloc(threads, sizeof(struct SquirrelBlock));
+    if (births == NULL) {
+        fprintf(stderr, "[ThreadEngine] Can not allocate the birth blocks of %d threads\n", threads);
+        return 1;
+    }
+
+    initialiseLand();
+    initialiseSquirrels();
+
+    remainSquirrel = INITIAL_NUMBER_OF_SQUIRRELS;
+    infectedSquirrel = INITIAL_INFECTION_LEVEL;
+    totalDeadSquirrel = 0;
+    month = 0;
+    steps = 0;
+
+    start = omp_get_wtime();
+    while (month < MONTH_LIMIT && remainSquirrel > 0 && remainSquirrel < MAX_SQUIRREL_NUMBER) {
+        stepAll();
+        steps++;
+        if (steps % STEPS_PER_MONTH == 0) {
+            month++;
+            renewMonth();
+            printMonthLog(month, remainSquirrel, infectedSquirrel, totalDeadSquirrel, popNInf, LENGTH_OF_LAND);
+        }
+    }
+
+    if (month < MONTH_LIMIT) {
+        // Print the last output if there is no enough months, the land reports the month it is in
+        for (t=0; t<LENGTH_OF_LAND; t++) {
+            popNInf[t*2] = population[t * LAST_POPULATION_MONTHS + RING_SLOT(month, LAST_POPULATION_MONTHS)];
+            popNInf[t*2+1] = infection[t * LAST_INFECTION_MONTHS + RING_SLOT(month, LAST_INFECTION_MONTHS)];
+        }
+        printf("[Last output]");
+        printMonthLog(month, remainSquirrel, infectedSquirrel, totalDeadSquirrel, popNInf, LENGTH_OF_LAND);
+    }
+    end = omp_get_wtime();
+
+    printf("Threaded engine stop. Runtime %f s on %d threads\n", end-start, threads);
+
+    for (t=0; t<threads; t++)
+        freeSquirrelBlock(&births[t]);
+    free(births);
+    freeSquirrelBlock(&squirrels);
+    free(population);
+    free(infection);
+    free(populationSum);
+    free(infectionSum);
+    free(popNInf);
+    return 0;
+}
+
+/**
+ * @brief Allocate the land cells, every month of every cell starts clean
+ *
+ */
+static void initialiseLand(){
+    population = (int *) calloc(LENGTH_OF_LAND * LAST_POPULATION_MONTHS, sizeof(int));
+    infection = (int *) calloc(LENGTH_OF_LAND * LAST_INFECTION_MONTHS, sizeof(int));
+    populationSum = (int *) calloc(LENGTH_OF_LAND, sizeof(int));
+    infectionSum = (int *) calloc(LENGTH_OF_LAND, sizeof(int));
+    popNInf = (int *) calloc(LENGTH_OF_LAND * 2, sizeof(int));
+
+    if (population == NULL || infection == NULL || populationSum == NULL || infectionSum == NULL || popNInf == NULL) {
+        fprintf(stderr, "[ThreadEngine] Can not allocate %d land cells\n", LENGTH_OF_LAND);
+        exit(1);
+    }
+}
+
+/**
+ * @brief Create the initial squirrels at random positions, the first INITIAL_INFECTION_LEVEL of them are sick.
+ * The squirrels are numbered as the MPI version numbers them, so they start at the same positions.
+ *
+ */
+static void initialiseSquirrels(){
+    int i;
+    float x, y;
+    struct SquirrelRNG rng;
+
+    if (reserveSquirrelBlock(&squirrels, INITIAL_NUMBER_OF_SQUIRRELS)) growError(&squirrels);
+
+    for (i=0; i<INITIAL_NUMBER_OF_SQUIRRELS; i++) {
+        seedSquirrelRNG(&rng, SQUIRREL_RNG_SEED, (uint64_t) i);
+        seekSquirrelRNG(&rng, 0, SQUIRREL_RNG_PLACE);
+        squirrelStep(0, 0, &x, &y, &rng);
+        if (addSquirrelToBlock(&squirrels, (uint64_t) i, x, y, i < INITIAL_INFECTION_LEVEL ? SICK : HEALTHY) < 0)
+            growError(&squirrels);
+    }
+}
+
+/**
+ * @brief Every squirrel makes one step. The squirrels are shared out over the threads, the babies are
+ * appended after the step in thread order and the dead squirrels are removed from the block.
+ *
+ */
+static void stepAll(){
+    int i, j, t, n, deaths;
+
+    n = squirrels.count;
+    deaths = 0;
+
+    #pragma omp parallel private(i) reduction(+:deaths)
+    {
+        struct SquirrelBlock * babies = &births[omp_get_thread_num()];
+        #pragma omp for schedule(static)
+        for (i=0; i<n; i++)
+            deaths += squirlGoShared(i, babies);
+    }
+
+    // The babies start to move from the next step
+    for (t=0; t<threads; t++) {
+        for (j=0; j<births[t].count; j++) {
+            if (addSquirrelToBlock(&squirrels, births[t].id[j], births[t].x[j], births[t].y[j], HEALTHY) < 0)
+                growError(&squirrels);
+        }
+        births[t].count = 0;
+    }
+
+    if (deaths)
+        removeDeadSquirrelsFromBlock(&squirrels);
+}
+
+/**
+ * @brief The squirrel i move and try to catch disease, reproduce and die.
+ * This is the same as squirlGo in squirrelActor.c, but the land and the controller counters are shared.
+ * @param[in] i
+ * The index of the squirrel in the block
+ * @param[out] babies
+ * The block of this thread that collects the babies
+ * @return 1 if the squirrel died in this step, otherwise 0
+ *
+ */
+static int squirlGoShared(int i, struct SquirrelBlock * babies){
+    int position, recvBuffer[2], catchDisease, giveBirth, die;
+    struct SquirrelRNG rng;
+
+    // The generator has no state of its own, so any thread can step the squirrel
+    seedSquirrelRNG(&rng, SQUIRREL_RNG_SEED, squirrels.id[i]);
+    seekSquirrelRNG(&rng, squirrels.steps[i], SQUIRREL_RNG_MOVE);
+    squirrelStep(squirrels.x[i], squirrels.y[i], &squirrels.x[i], &squirrels.y[i], &rng);
+    position = getCellFromPosition(squirrels.x[i], squirrels.y[i]);
+
+    visitLand(position, squirrels.state[i], recvBuffer);
+
+    seekSquirrelRNG(&rng, squirrels.steps[i], SQUIRREL_RNG_LIFE);
+
+    // Update population and infection level
+    recordBlockVisit(&squirrels, i, recvBuffer[0], recvBuffer[1]);
+
+    squirrels.steps[i]++;
+
+    if (squirrels.state[i] == SICK)
+        squirrels.sickSteps[i]++;
+
+    // The numbers of the step are drawn in the same order whatever the squirrel does, as the MPI version does
+    catchDisease = willCatchDisease(getBlockAvgInfLevel(&squirrels, i), &rng);
+    giveBirth = willGiveBirth(getBlockAvgPop(&squirrels, i), &rng);
+    die = willDie(&rng);
+
+    // The squirrel will catches disease
+    if (squirrels.steps[i] > CATCH_DISEASE_STEPS && squirrels.state[i] == HEALTHY && catchDisease) {
+        squirrels.state[i] = SICK;
+        #pragma omp atomic
+        infectedSquirrel++;
+    }
+
+    // The squirrel will give birth
+    if (squirrels.steps[i] % GIVE_BIRTH_STEPS == 0 && giveBirth)
+        reproduceShared(i, &rng, babies);
+
+    // The squirrel will die
+    if (squirrels.sickSteps[i] > 50 && die) {
+        squirrels.state[i] = NOT_EXIST;
+        #pragma omp atomic
+        remainSquirrel--;
+        #pragma omp atomic
+        infectedSquirrel--;
+        #pragma omp atomic
+        totalDeadSquirrel++;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief The squirrel visits the land cell. This does what updateLand in landActor.c does, with atomics
+ * on the shared cell instead of messages.
+ * @param[in] position
+ * The land cell the squirrel is in
+ * @param[in] state
+ * The state of the squirrel
+ * @param[out] recvBuffer
+ * The population influx and the infection level of the cell
+ *
+ */
+static void visitLand(int position, int state, int * recvBuffer){
+    #pragma omp atomic
+    population[position * LAST_POPULATION_MONTHS + RING_SLOT(month, LAST_POPULATION_MONTHS)]++;
+    // The cell keeps running sums of its window, the visit gets the sums with its own visit counted
+    #pragma omp atomic capture
+    recvBuffer[0] = ++populationSum[position];
+
+    if (state == SICK) {
+        #pragma omp atomic
+        infection[position * LAST_INFECTION_MONTHS + RING_SLOT(month, LAST_INFECTION_MONTHS)]++;
+        #pragma omp atomic capture
+        recvBuffer[1] = ++infectionSum[position];
+    } else {
+        #pragma omp atomic read
+        recvBuffer[1] = infectionSum[position];
+    }
+}
+
+/**
+ * @brief The squirrel gives birth if the number of squirrels is under the limit, the check and the count
+ * is done with one atomic as the controller does in countSquirrels
+ * @param[in] parent
+ * The index of the parent squirrel in the block
+ * @param[in] rng
+ * The generator of the parent, the baby's stream id is drawn from its SQUIRREL_RNG_CHILD stream
+ * @param[out] babies
+ * The block of this thread that collects the babies
+ *
+ */
+static void reproduceShared(int parent, struct SquirrelRNG * rng, struct SquirrelBlock * babies){
+    int alive;
+    uint64_t childId;
+
+    // The parent's steps already count this step
+    seekSquirrelRNG(rng, squirrels.steps[parent] - 1, SQUIRREL_RNG_CHILD);
+    childId = squirrelRandomId(rng);
+
+    #pragma omp atomic capture
+    alive = ++remainSquirrel;
+
+    if (alive > MAX_SQUIRREL_NUMBER) {
+        // The number of squirrels is out of limit
+        #pragma omp atomic
+        remainSquirrel--;
+        return;
+    }
+
+    if (addSquirrelToBlock(babies, childId, squirrels.x[parent], squirrels.y[parent], HEALTHY) < 0)
+        growError(babies);
+}
+
+/**
+ * @brief The land cells report the month that just finished and clean the oldest population and
+ * infection level for the new month, as renewMonth in landActor.c does
+ *
+ */
+static void renewMonth(){
+    int i;
+    for (i=0; i<LENGTH_OF_LAND; i++) {
+        popNInf[i*2] = population[i * LAST_POPULATION_MONTHS + RING_SLOT(month - 1, LAST_POPULATION_MONTHS)];
+        popNInf[i*2+1] = infection[i * LAST_INFECTION_MONTHS + RING_SLOT(month - 1, LAST_INFECTION_MONTHS)];
+        populationSum[i] -= population[i * LAST_POPULATION_MONTHS + RING_SLOT(month, LAST_POPULATION_MONTHS)];
+        infectionSum[i] -= infection[i * LAST_INFECTION_MONTHS + RING_SLOT(month, LAST_INFECTION_MONTHS)];
+        population[i * LAST_POPULATION_MONTHS + RING_SLOT(month, LAST_POPULATION_MONTHS)] = 0;
+        infection[i * LAST_INFECTION_MONTHS + RING_SLOT(month, LAST_INFECTION_MONTHS)] = 0;
+    }
+}
+
+/**
+ * @brief Writes an error message to stderr and quits when a block can not grow
+ *
+ */
+static void growError(struct SquirrelBlock * block){
+    fprintf(stderr, "[ThreadEngine] Can not grow the block of %d squirrels\n", block->count);
+    exit(1);
+}
@@ -0,0 +1,161 @@
+//
+// Created by Ray on 2020/4/7.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "../include/trace.h"
+#include "../include/framework.h"
+#include "../include/config.h"
+
+/** The tag the spans go to the master with, after the pool is finalised **/
+#define TRACE_TAG 1100
+
+/** A span of the timeline, from the start of the trace in seconds **/
+struct TraceSpan {
+    double begin;
+    double duration;
+    int kind;
+};
+
+static const char * traceKindNames[TRACE_KINDS] = {"controller", "land", "squirrel", "batch", "startWorkerProcess",
+    "land reply", "month barrier", "workerSleep"};
+
+/** The ring of the spans of this process, traceNext counts all the spans so the ring has min(traceNext, traceCapacity) **/
+static struct TraceSpan * traceRing;
+static int traceCapacity;
+static long traceNext;
+static double traceStart;
+static int traceEnabled;
+
+static void writeTraceSpans(FILE * file, int rank, struct TraceSpan * spans, int count);
+
+/**
+ * @brief Start the trace. It is collective over simComm, the processes start their clocks after one barrier so
+ * their spans line up to within the barrier.
+ * @param[in] enabled
+ * Nothing is recorded if it is 0
+ * @param[in] events
+ * The spans each process keeps
+ *
+ */
+void startTrace(int enabled, int events){
+    traceEnabled = enabled;
+    if (!enabled)
+        return;
+
+    traceRing = (struct TraceSpan *) malloc(sizeof(struct TraceSpan) * events);
+    if (traceRing == NULL) {
+        fprintf(stderr, "[Trace] Can not allocate the ring of %d spans\n", events);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    traceCapacity = events;
+    traceNext = 0;
+
+    MPI_Barrier(simComm);
+    traceStart = MPI_Wtime();
+}
+
+/**
+ * @brief The time a span begins at, if the trace is on
+ * @return The time, or 0
+ *
+ */
+double traceBegin(){
+    return traceEnabled ? MPI_Wtime() : 0;
+}
+
+/**
+ * @brief Add a span that began at begin and ends now to the ring, over the oldest span if the ring is full
+ * @param[in] kind
+ * An actor identity or one of the waits of trace.h
+ * @param[in] begin
+ * The time traceBegin returned
+ *
+ */
+void traceEnd(int kind, double begin){
+    struct TraceSpan * span;
+    if (!traceEnabled)
+        return;
+
+    span = &traceRing[traceNext++ % traceCapacity];
+    span->begin = begin - traceStart;
+    span->duration = MPI_Wtime() - begin;
+    span->kind = kind;
+}
+
+/**
+ * @brief Write the spans of all the processes of the simulation to a Chrome trace, every rank is a thread of the
+ * timeline. It is collective over simComm, every process calls it after the pool is finalised. The master takes
+ * the rings one process after the other, so it holds one ring at a time.
+ * @param[in] path
+ *
+ */
+void writeTrace(const char * path){
+    int rank, size, source;
+    long dropped, counts[2];
+    FILE * file = NULL;
+
+    MPI_Comm_rank(simComm, &rank);
+    MPI_Comm_size(simComm, &size);
+    counts[0] = traceNext < traceCapacity ? traceNext : traceCapacity;
+    counts[1] = traceNext - counts[0];
+
+    if (rank != 0) {
+        MPI_Send(counts, 2, MPI_LONG, 0, TRACE_TAG, simComm);
+        MPI_Send(traceRing, (int) (counts[0] * sizeof(struct TraceSpan)), MPI_BYTE, 0, TRACE_TAG, simComm);
+        free(traceRing);
+        return;
+    }
+
+    file = fopen(path, "w");
+    if (file == NULL)
+        fprintf(stderr, "[Trace] Can not open the trace %s\n", path);
+    if (file != NULL) {
+        fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"replica %d\"}}",
+                ensembleReplica, ensembleReplica);
+    }
+
+    dropped = counts[1];
+    for (source=0; source<size; source++) {
+        if (source != 0) {
+            MPI_Recv(counts, 2, MPI_LONG, source, TRACE_TAG, simComm, MPI_STATUS_IGNORE);
+            MPI_Recv(traceRing, (int) (counts[0] * sizeof(struct TraceSpan)), MPI_BYTE, source, TRACE_TAG, simComm,
+                     MPI_STATUS_IGNORE);
+            dropped += counts[1];
+        }
+        if (file != NULL)
+            writeTraceSpans(file, source, traceRing, (int) counts[0]);
+    }
+
+    if (file != NULL) {
+        fprintf(file, "\n], \"otherData\": {\"ranks\": %d, \"spansPerRank\": %d, \"droppedSpans\": %ld}}\n", size,
+                traceCapacity, dropped);
+        fclose(file);
+        printf("Trace of %d ranks written to %s, %ld spans dropped\n", size, path, dropped);
+    }
+    free(traceRing);
+}
+
+/**
+ * @brief Write the name of the thread of a rank and its spans as complete events, in microseconds. The events
+ * follow the process name, so each one starts with a comma.
+ * @param[in] file
+ * @param[in] rank
+ * @param[in] spans
+ * @param[in] count
+ *
+ */
+static void writeTraceSpans(FILE * file, int rank, struct TraceSpan * spans, int count){
+    int i;
+
+    fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+            ensembleReplica, rank, rank == 0 ? "master" : "rank", rank);
+    for (i=0; i<count; i++) {
+        fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                traceKindNames[spans[i].kind], spans[i].kind < TRACE_SPAWN ? "actor" : "wait", ensembleReplica, rank,
+                spans[i].begin * 1e6, spans[i].duration * 1e6);
+    }
+}
@@ -0,0 +1,83 @@
+#!/bin/bash
+#
+# Runs the fixed benchmark workloads of the simulation and writes their numbers as one JSON array.
+# The months are step-synchronous, so a workload does the same squirrel steps on any machine.
+#
+#   make benchmark                                # or tools/benchmark.sh
+#   RANKS="4 8 16 32 64" MPIRUN="mpiexec_mpt -ppn 36" tools/benchmark.sh
+#
+# RANKS     the rank counts of the scaling sweeps, at least 4 (the master, the controller, a land actor and a
+#           batched squirrel actor), the largest one also runs the size sweeps
+# MPIRUN    the launcher, it gets -n <ranks>
+# MONTHS    the months of every run
+# OUTPUT    the JSON file, an array of {"sweep": ..., "result": {...}}
+
+RUN=${RUN:-bin/run}
+MPIRUN=${MPIRUN:-mpirun}
+RANKS=${RANKS:-"4 8 16"}
+MONTHS=${MONTHS:-4}
+OUTPUT=${OUTPUT:-benchmark.json}
+SCRATCH=$(mktemp -d)
+trap 'rm -rf $SCRATCH' EXIT
+
+first=1
+echo "[" > $OUTPUT
+
+# run <sweep> <ranks> <land width> <land height> <squirrels> [NAME=value ...]
+# Half of the workers are land actors and half are batched squirrel actors
+run() {
+    local sweep=$1 ranks=$2 width=$3 height=$4 squirrels=$5
+    shift 5
+    if [ $ranks -lt 4 ]; then
+        echo "$sweep: $ranks ranks are too few, skipped" >&2
+        return
+    fi
+    local workers=$((ranks - 2))
+    local lands=$((workers / 2))
+    local cells=$((width * height))
+    [ $lands -lt 1 ] && lands=1
+    [ $lands -gt $cells ] && lands=$cells
+    local batches=$((workers - lands))
+
+    echo "$sweep: $ranks ranks, $width x $height cells, $squirrels squirrels" >&2
+    rm -f $SCRATCH/result.json
+    $MPIRUN -n $ranks $RUN STEP_SYNC_MONTHS=1 ACCOUNTING_REDUCE_MODE=1 BIRTH_LEASE_SIZE=64 MONTH_LIMIT=$MONTHS \
+        LAND_WIDTH=$width LAND_HEIGHT=$height LAND_ACTORS=$lands SQUIRREL_BATCH_ACTORS=$batches \
+        INITIAL_NUMBER_OF_SQUIRRELS=$squirrels INITIAL_INFECTION_LEVEL=$(((squirrels + 9) / 10)) \
+        MAX_SQUIRREL_NUMBER=$((squirrels * 2)) MONTH_OUTPUT=$SCRATCH/months.bin \
+        BENCHMARK_OUTPUT=$SCRATCH/result.json "$@" > $SCRATCH/run.log 2>&1
+    if [ ! -s $SCRATCH/result.json ]; then
+        echo "$sweep: the run failed, see below" >&2
+        tail -n 20 $SCRATCH/run.log >&2
+        return
+    fi
+
+    [ $first -eq 0 ] && echo "," >> $OUTPUT
+    first=0
+    printf '{"sweep": "%s", "result": %s}' $sweep "$(cat $SCRATCH/result.json)" >> $OUTPUT
+}
+
+largest=$(echo $RANKS | tr ' ' '\n' | sort -n | tail -n 1)
+
+# The squirrels and the land on the largest rank count
+for squirrels in 34 1000 10000 100000 1000000; do
+    run squirrels $largest 4 4 $squirrels
+done
+for side in 4 100 316 1000; do
+    run land $largest $side $side 1000
+done
+
+# Strong scaling, the same workload on more ranks
+for ranks in $RANKS; do
+    run strong $ranks 100 100 100000
+done
+
+# Weak scaling, 10^4 cells per land actor and 10^4 squirrels per batched squirrel actor
+for ranks in $RANKS; do
+    workers=$((ranks - 2))
+    run weak $ranks $((100 * (workers / 2))) 100 $((10000 * (workers - workers / 2)))
+done
+
+echo "" >> $OUTPUT
+echo "]" >> $OUTPUT
+echo "Wrote $OUTPUT" >&2
@@ -0,0 +1,60 @@
+/*
+ * Converts the binary month output of a simulation (MONTH_OUTPUT, see include/monthRecord.h) to the text the
+ * simulation prints on stdout without it. It is built without MPI with `make tools`, and run as
+ * `bin/month-record-text file`, the text goes to stdout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/monthLog.h"
+#include "../include/monthRecord.h"
+
+int main(int argc, char * argv[]) {
+    char magic[MONTH_RECORD_MAGIC_SIZE];
+    int header[2], counts[MONTH_RECORD_COUNTS], cells, * popNInf;
+    FILE * file;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s file\n", argv[0]);
+        return 1;
+    }
+
+    file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Can not open %s\n", argv[1]);
+        return 1;
+    }
+
+    if (fread(magic, 1, MONTH_RECORD_MAGIC_SIZE, file) != MONTH_RECORD_MAGIC_SIZE ||
+        memcmp(magic, MONTH_RECORD_MAGIC, MONTH_RECORD_MAGIC_SIZE) != 0 || fread(header, sizeof(int), 2, file) != 2) {
+        fprintf(stderr, "%s is not a month output of the simulation\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+
+    // Without the cells the months are printed with empty cell lists
+    cells = header[MONTH_RECORD_HEADER_WITH_CELLS] ? header[MONTH_RECORD_HEADER_CELLS] : 0;
+    popNInf = (int *) malloc(sizeof(int) * (cells > 0 ? cells * 2 : 1));
+    if (popNInf == NULL) {
+        fprintf(stderr, "Can not allocate the %d cells\n", cells);
+        fclose(file);
+        return 1;
+    }
+
+    while (fread(counts, sizeof(int), MONTH_RECORD_COUNTS, file) == MONTH_RECORD_COUNTS) {
+        if (fread(popNInf, sizeof(int), cells * 2, file) != (size_t) cells * 2) {
+            fprintf(stderr, "%s ends in the middle of month %d\n", argv[1], counts[MONTH_RECORD_MONTH]);
+            break;
+        }
+        if (counts[MONTH_RECORD_LAST])
+            printf("[Last output]");
+        printMonthLog(counts[MONTH_RECORD_MONTH], counts[MONTH_RECORD_ALIVE], counts[MONTH_RECORD_INFECTED],
+                      counts[MONTH_RECORD_DEAD], popNInf, cells);
+    }
+
+    free(popNInf);
+    fclose(file);
+    return 0;
+}